@@ -0,0 +1,744 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "eagle.h"
+#include "aof.h"
+#include "storage.h"
+#include "protocol.h"
+#include "queue_t.h"
+#include "object.h"
+#include "message.h"
+#include "xmalloc.h"
+#include "utils.h"
+
+#define EG_AOF_OLD_SUFFIX ".old"
+
+static char *aof_old_file(void)
+{
+	static char filename[PATH_MAX];
+
+	snprintf(filename, sizeof(filename), "%s%s", server->aof_file, EG_AOF_OLD_SUFFIX);
+
+	return filename;
+}
+
+static void aof_reserve(size_t length)
+{
+	size_t size = server->aof_bufsize ? server->aof_bufsize : EG_AOF_BUF_SIZE;
+
+	if (server->aof_buflen + length <= server->aof_bufsize) {
+		return;
+	}
+
+	while (size < server->aof_buflen + length) {
+		size *= 2;
+	}
+
+	server->aof_buf = (char*)xrealloc(server->aof_buf, size);
+	server->aof_bufsize = size;
+}
+
+static inline void aof_append(const void *data, size_t length)
+{
+	memcpy(server->aof_buf + server->aof_buflen, data, length);
+	server->aof_buflen += length;
+}
+
+static inline void aof_append_data(const void *data, uint32_t length)
+{
+	aof_append(&length, sizeof(length));
+	aof_append(data, length);
+}
+
+static size_t aof_begin_record(int type, size_t length)
+{
+	size_t start = server->aof_buflen;
+	uint64_t time = server->now_timems;
+	uint32_t size = 0;
+	unsigned char record = type;
+
+	aof_reserve(EG_AOF_RECORD_HEADER_SIZE + length);
+
+	server->aof_seq++;
+
+	aof_append(&size, sizeof(size));
+	aof_append(&record, sizeof(record));
+	aof_append(&server->aof_seq, sizeof(server->aof_seq));
+	aof_append(&time, sizeof(time));
+
+	return start;
+}
+
+static void aof_end_record(size_t start)
+{
+	uint32_t size = server->aof_buflen - start - sizeof(uint32_t);
+
+	memcpy(server->aof_buf + start, &size, sizeof(size));
+}
+
+static inline int aof_queue_t(Queue_t *queue_t)
+{
+	return server->aof_fd != -1 && BIT_CHECK(queue_t->flags, EG_QUEUE_DURABLE_FLAG);
+}
+
+static void aof_log_queue_record(Queue_t *queue_t, int type)
+{
+	size_t start;
+
+	if (!aof_queue_t(queue_t)) {
+		return;
+	}
+
+	start = aof_begin_record(type, sizeof(uint32_t) + 64);
+	aof_append_data(queue_t->name, strlenz(queue_t->name));
+	aof_end_record(start);
+}
+
+static void aof_log_time_record(Queue_t *queue_t, int type, uint32_t time)
+{
+	size_t start;
+
+	if (!aof_queue_t(queue_t)) {
+		return;
+	}
+
+	start = aof_begin_record(type, sizeof(uint32_t) * 2 + 64);
+	aof_append_data(queue_t->name, strlenz(queue_t->name));
+	aof_append(&time, sizeof(time));
+	aof_end_record(start);
+}
+
+void aof_log_queue_create(Queue_t *queue_t)
+{
+	size_t start;
+
+	if (!aof_queue_t(queue_t)) {
+		return;
+	}
+
+	start = aof_begin_record(EG_AOF_QUEUE_CREATE, sizeof(uint32_t) * 4 + 64);
+	aof_append_data(queue_t->name, strlenz(queue_t->name));
+	aof_append(&queue_t->max_msg, sizeof(queue_t->max_msg));
+	aof_append(&queue_t->max_msg_size, sizeof(queue_t->max_msg_size));
+	aof_append(&queue_t->flags, sizeof(queue_t->flags));
+	aof_end_record(start);
+}
+
+void aof_log_queue_rename(Queue_t *queue_t, const char *name)
+{
+	size_t start;
+
+	if (!aof_queue_t(queue_t)) {
+		return;
+	}
+
+	start = aof_begin_record(EG_AOF_QUEUE_RENAME, sizeof(uint32_t) * 2 + 128);
+	aof_append_data(queue_t->name, strlenz(queue_t->name));
+	aof_append_data(name, strlenz(name));
+	aof_end_record(start);
+}
+
+void aof_log_queue_purge(Queue_t *queue_t)
+{
+	aof_log_queue_record(queue_t, EG_AOF_QUEUE_PURGE);
+}
+
+void aof_log_queue_delete(Queue_t *queue_t)
+{
+	aof_log_queue_record(queue_t, EG_AOF_QUEUE_DELETE);
+}
+
+void aof_log_message_push(Queue_t *queue_t, Message *msg)
+{
+	size_t start;
+
+	if (!aof_queue_t(queue_t)) {
+		return;
+	}
+
+	start = aof_begin_record(EG_AOF_MESSAGE_PUSH, sizeof(uint32_t) * 3 +
+		sizeof(uint64_t) + 64 + EG_MESSAGE_SIZE(msg));
+	aof_append_data(queue_t->name, strlenz(queue_t->name));
+	aof_append(&msg->tag, sizeof(msg->tag));
+	aof_append(&msg->expiration, sizeof(msg->expiration));
+	aof_append_data(EG_MESSAGE_VALUE(msg), EG_MESSAGE_SIZE(msg));
+	aof_end_record(start);
+}
+
+void aof_log_message_pop(Queue_t *queue_t, Message *msg, uint32_t timeout)
+{
+	size_t start;
+
+	if (!aof_queue_t(queue_t)) {
+		return;
+	}
+
+	start = aof_begin_record(EG_AOF_MESSAGE_POP, sizeof(uint32_t) * 2 + sizeof(uint64_t) + 64);
+	aof_append_data(queue_t->name, strlenz(queue_t->name));
+	aof_append(&msg->tag, sizeof(msg->tag));
+	aof_append(&timeout, sizeof(timeout));
+	aof_end_record(start);
+}
+
+void aof_log_message_confirm(Queue_t *queue_t, uint64_t tag)
+{
+	size_t start;
+
+	if (!aof_queue_t(queue_t)) {
+		return;
+	}
+
+	start = aof_begin_record(EG_AOF_MESSAGE_CONFIRM, sizeof(uint32_t) + sizeof(uint64_t) + 64);
+	aof_append_data(queue_t->name, strlenz(queue_t->name));
+	aof_append(&tag, sizeof(tag));
+	aof_end_record(start);
+}
+
+void aof_log_messages_expire(Queue_t *queue_t, uint32_t time)
+{
+	aof_log_time_record(queue_t, EG_AOF_MESSAGE_EXPIRE, time);
+}
+
+void aof_log_messages_redeliver(Queue_t *queue_t, uint32_t time)
+{
+	aof_log_time_record(queue_t, EG_AOF_MESSAGE_REDELIVER, time);
+}
+
+int aof_writable(Queue_t *queue_t)
+{
+	return !server->aof_failed || !aof_queue_t(queue_t);
+}
+
+static int aof_write(int fd, const char *data, size_t length)
+{
+	ssize_t nwritten;
+
+	while (length)
+	{
+		nwritten = write(fd, data, length);
+		if (nwritten == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return EG_STATUS_ERR;
+		}
+
+		data += nwritten;
+		length -= nwritten;
+	}
+
+	return EG_STATUS_OK;
+}
+
+static int aof_sync(void)
+{
+	if (fdatasync(server->aof_fd) == -1) {
+		warning("Error sync append only file %s: %s", server->aof_file, strerror(errno));
+		return EG_STATUS_ERR;
+	}
+
+	server->aof_unsynced = 0;
+	server->aof_last_fsync = server->now_time;
+
+	return EG_STATUS_OK;
+}
+
+static int aof_truncate(void)
+{
+	if (ftruncate(server->aof_fd, server->aof_size) == -1) {
+		warning("Error truncate append only file %s: %s", server->aof_file, strerror(errno));
+		return EG_STATUS_ERR;
+	}
+
+	return EG_STATUS_OK;
+}
+
+int aof_flush(void)
+{
+	if (server->aof_fd == -1 || (!server->aof_buflen && !server->aof_failed)) {
+		return EG_STATUS_OK;
+	}
+
+	if (server->aof_failed && aof_truncate() != EG_STATUS_OK) {
+		return EG_STATUS_ERR;
+	}
+
+	if (aof_write(server->aof_fd, server->aof_buf, server->aof_buflen) != EG_STATUS_OK) {
+		warning("Error write append only file %s: %s", server->aof_file, strerror(errno));
+		server->aof_failed = 1;
+		aof_truncate();
+		return EG_STATUS_ERR;
+	}
+
+	server->aof_size += server->aof_buflen;
+	server->aof_buflen = 0;
+	server->aof_unsynced = 1;
+
+	if (server->aof_bufsize > EG_AOF_BUF_SIZE * 16)
+	{
+		xfree(server->aof_buf);
+		server->aof_buf = NULL;
+		server->aof_bufsize = 0;
+	}
+
+	if (server->aof_fsync == EG_AOF_FSYNC_ALWAYS && aof_sync() != EG_STATUS_OK) {
+		server->aof_failed = 1;
+		return EG_STATUS_ERR;
+	}
+
+	server->aof_failed = 0;
+	server->aof_flushed_seq = server->aof_seq;
+
+	return EG_STATUS_OK;
+}
+
+void aof_timeout(void)
+{
+	if (server->aof_fd == -1) {
+		return;
+	}
+
+	aof_flush();
+
+	if (server->aof_fsync == EG_AOF_FSYNC_EVERYSEC && server->aof_unsynced &&
+		server->now_time != server->aof_last_fsync) {
+		aof_sync();
+	}
+}
+
+int aof_open(void)
+{
+	server->aof_fd = open(server->aof_file, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (server->aof_fd == -1) {
+		warning("Failed opening append only file %s: %s", server->aof_file, strerror(errno));
+		return EG_STATUS_ERR;
+	}
+
+	server->aof_size = lseek(server->aof_fd, 0, SEEK_END);
+	server->aof_flushed_seq = server->aof_seq;
+	server->aof_last_fsync = server->now_time;
+
+	return EG_STATUS_OK;
+}
+
+void aof_close(void)
+{
+	if (server->aof_fd == -1) {
+		return;
+	}
+
+	aof_flush();
+	aof_sync();
+
+	close(server->aof_fd);
+	server->aof_fd = -1;
+
+	if (server->aof_buf) {
+		xfree(server->aof_buf);
+		server->aof_buf = NULL;
+		server->aof_bufsize = 0;
+	}
+}
+
+void aof_rotate(void)
+{
+	if (server->aof_fd == -1) {
+		return;
+	}
+
+	aof_flush();
+
+	if (access(aof_old_file(), F_OK) != -1) {
+		return;
+	}
+
+	aof_sync();
+	close(server->aof_fd);
+
+	if (rename(server->aof_file, aof_old_file()) == -1) {
+		warning("Error rename append only file %s: %s", server->aof_file, strerror(errno));
+	}
+
+	if (aof_open() != EG_STATUS_OK) {
+		fatal("Error reopen append only file %s", server->aof_file);
+	}
+}
+
+void aof_rotate_done(int status)
+{
+	if (server->aof_fd == -1 || status != EG_STATUS_OK) {
+		return;
+	}
+
+	unlink(aof_old_file());
+}
+
+void aof_reset(void)
+{
+	if (server->aof_fd == -1 || storage_save_in_progress()) {
+		return;
+	}
+
+	server->aof_buflen = 0;
+
+	if (ftruncate(server->aof_fd, 0) == -1) {
+		warning("Error truncate append only file %s: %s", server->aof_file, strerror(errno));
+		return;
+	}
+
+	server->aof_size = 0;
+	server->aof_failed = 0;
+	server->aof_flushed_seq = server->aof_seq;
+
+	aof_sync();
+	unlink(aof_old_file());
+}
+
+typedef struct AofReader {
+	char *data;
+	size_t length;
+	size_t pos;
+} AofReader;
+
+static int aof_read(AofReader *reader, void *data, size_t length)
+{
+	if (reader->length - reader->pos < length) {
+		return EG_STATUS_ERR;
+	}
+
+	memcpy(data, reader->data + reader->pos, length);
+	reader->pos += length;
+
+	return EG_STATUS_OK;
+}
+
+static int aof_read_name(AofReader *reader, char *name, uint32_t maxlen)
+{
+	uint32_t length;
+
+	if (aof_read(reader, &length, sizeof(length)) != EG_STATUS_OK || length > maxlen || !length) {
+		return EG_STATUS_ERR;
+	}
+
+	if (aof_read(reader, name, length) != EG_STATUS_OK) {
+		return EG_STATUS_ERR;
+	}
+
+	name[length - 1] = '\0';
+
+	return EG_STATUS_OK;
+}
+
+static Object *aof_read_object(AofReader *reader)
+{
+	Object *object;
+	uint32_t length;
+
+	if (aof_read(reader, &length, sizeof(length)) != EG_STATUS_OK || reader->length - reader->pos < length) {
+		return NULL;
+	}
+
+	object = create_dup_object(reader->data + reader->pos, length);
+	reader->pos += length;
+
+	return object;
+}
+
+static int aof_replay_queue_create(AofReader *reader)
+{
+	Queue_t data;
+
+	if (aof_read_name(reader, data.name, sizeof(data.name)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (aof_read(reader, &data.max_msg, sizeof(data.max_msg)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (aof_read(reader, &data.max_msg_size, sizeof(data.max_msg_size)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (aof_read(reader, &data.flags, sizeof(data.flags)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (!find_queue_t(data.name)) {
+		register_queue_t(create_queue_t(data.name, data.max_msg, data.max_msg_size, data.flags));
+	}
+
+	return EG_STATUS_OK;
+}
+
+static int aof_replay_queue_rename(AofReader *reader, Queue_t *queue_t)
+{
+	char name[64];
+
+	if (aof_read_name(reader, name, sizeof(name)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (queue_t && !find_queue_t(name)) {
+		rename_queue_t(queue_t, name);
+	}
+
+	return EG_STATUS_OK;
+}
+
+static int aof_replay_message_push(AofReader *reader, Queue_t *queue_t)
+{
+	Object *data;
+	uint64_t tag;
+	uint32_t expiration;
+
+	if (aof_read(reader, &tag, sizeof(tag)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (aof_read(reader, &expiration, sizeof(expiration)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if ((data = aof_read_object(reader)) == NULL)
+		return EG_STATUS_ERR;
+
+	if (queue_t) {
+		restore_message_queue_t(queue_t, data, tag, expiration);
+	}
+
+	decrement_references_count(data);
+
+	return EG_STATUS_OK;
+}
+
+static int aof_replay_message_pop(AofReader *reader, Queue_t *queue_t)
+{
+	Message *msg;
+	uint64_t tag;
+	uint32_t timeout;
+
+	if (aof_read(reader, &tag, sizeof(tag)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (aof_read(reader, &timeout, sizeof(timeout)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (queue_t && (msg = get_message_queue_t(queue_t)) != NULL && msg->tag == tag) {
+		pop_message_queue_t(queue_t, timeout);
+	}
+
+	return EG_STATUS_OK;
+}
+
+static int aof_replay_message_confirm(AofReader *reader, Queue_t *queue_t)
+{
+	uint64_t tag;
+
+	if (aof_read(reader, &tag, sizeof(tag)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (queue_t) {
+		confirm_message_queue_t(queue_t, tag);
+	}
+
+	return EG_STATUS_OK;
+}
+
+static int aof_replay_messages_timer(AofReader *reader, Queue_t *queue_t, int type)
+{
+	uint32_t time;
+
+	if (aof_read(reader, &time, sizeof(time)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (!queue_t) {
+		return EG_STATUS_OK;
+	}
+
+	if (type == EG_AOF_MESSAGE_EXPIRE) {
+		process_expired_messages_queue_t(queue_t, time);
+	} else {
+		process_unconfirmed_messages_queue_t(queue_t, time);
+	}
+
+	schedule_queue_t(queue_t);
+
+	return EG_STATUS_OK;
+}
+
+static int aof_replay_record(AofReader *reader)
+{
+	Queue_t *queue_t;
+	char name[64];
+	unsigned char type;
+	uint64_t seq, time;
+
+	if (aof_read(reader, &type, sizeof(type)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (aof_read(reader, &seq, sizeof(seq)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (aof_read(reader, &time, sizeof(time)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (seq <= server->aof_seq) {
+		return EG_STATUS_OK;
+	}
+
+	server->aof_seq = seq;
+	server->now_timems = time;
+
+	if (type == EG_AOF_QUEUE_CREATE) {
+		return aof_replay_queue_create(reader);
+	}
+
+	if (aof_read_name(reader, name, sizeof(name)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	queue_t = find_queue_t(name);
+
+	switch (type)
+	{
+		case EG_AOF_QUEUE_RENAME:
+			return aof_replay_queue_rename(reader, queue_t);
+
+		case EG_AOF_QUEUE_PURGE:
+			if (queue_t) purge_queue_t(queue_t);
+			return EG_STATUS_OK;
+
+		case EG_AOF_QUEUE_DELETE:
+			if (queue_t) unregister_queue_t(queue_t);
+			return EG_STATUS_OK;
+
+		case EG_AOF_MESSAGE_PUSH:
+			return aof_replay_message_push(reader, queue_t);
+
+		case EG_AOF_MESSAGE_POP:
+			return aof_replay_message_pop(reader, queue_t);
+
+		case EG_AOF_MESSAGE_CONFIRM:
+			return aof_replay_message_confirm(reader, queue_t);
+
+		case EG_AOF_MESSAGE_EXPIRE:
+		case EG_AOF_MESSAGE_REDELIVER:
+			return aof_replay_messages_timer(reader, queue_t, type);
+	}
+
+	return EG_STATUS_ERR;
+}
+
+static int aof_replay_file(const char *filename, int truncate_tail)
+{
+	AofReader reader;
+	FILE *fp;
+	char *buffer = NULL;
+	size_t bufsize = 0;
+	long offset = 0;
+	uint32_t length;
+	int records = 0;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		return errno == ENOENT ? EG_STATUS_OK : EG_STATUS_ERR;
+	}
+
+	while (fread(&length, sizeof(length), 1, fp) == 1)
+	{
+		if (length < EG_AOF_RECORD_HEADER_SIZE - sizeof(length) || length > EG_MAX_BUF_SIZE) {
+			goto error;
+		}
+
+		if (length > bufsize)
+		{
+			bufsize = length;
+			buffer = (char*)xrealloc(buffer, bufsize);
+		}
+
+		if (fread(buffer, length, 1, fp) != 1) {
+			break;
+		}
+
+		reader.data = buffer;
+		reader.length = length;
+		reader.pos = 0;
+
+		if (aof_replay_record(&reader) != EG_STATUS_OK) {
+			goto error;
+		}
+
+		offset += sizeof(length) + length;
+		records++;
+	}
+
+	if (offset != ftell(fp))
+	{
+		warning("Append only file %s has a partial record at offset %ld", filename, offset);
+
+		if (!truncate_tail || truncate(filename, offset) == -1) {
+			goto error;
+		}
+	}
+
+	if (buffer) {
+		xfree(buffer);
+	}
+
+	fclose(fp);
+
+	wlog("Loaded %d records from the append only file %s", records, filename);
+
+	return EG_STATUS_OK;
+
+error:
+	if (buffer) {
+		xfree(buffer);
+	}
+
+	fclose(fp);
+
+	warning("Error read append only file %s at offset %ld", filename, offset);
+
+	return EG_STATUS_ERR;
+}
+
+int aof_load(void)
+{
+	if (aof_replay_file(aof_old_file(), 0) != EG_STATUS_OK) {
+		return EG_STATUS_ERR;
+	}
+
+	if (aof_replay_file(server->aof_file, 1) != EG_STATUS_OK) {
+		return EG_STATUS_ERR;
+	}
+
+	return EG_STATUS_OK;
+}
@@ -0,0 +1,68 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __AOF_H__
+#define __AOF_H__
+
+#include <stdint.h>
+
+#include "eagle.h"
+#include "message.h"
+
+#define EG_AOF_BUF_SIZE 65536
+#define EG_AOF_RECORD_HEADER_SIZE 21
+
+#define EG_AOF_QUEUE_CREATE 0x1
+#define EG_AOF_QUEUE_RENAME 0x2
+#define EG_AOF_QUEUE_PURGE 0x3
+#define EG_AOF_QUEUE_DELETE 0x4
+#define EG_AOF_MESSAGE_PUSH 0x5
+#define EG_AOF_MESSAGE_POP 0x6
+#define EG_AOF_MESSAGE_CONFIRM 0x7
+#define EG_AOF_MESSAGE_EXPIRE 0x8
+#define EG_AOF_MESSAGE_REDELIVER 0x9
+
+int aof_load(void);
+int aof_open(void);
+void aof_close(void);
+int aof_flush(void);
+int aof_writable(Queue_t *queue_t);
+void aof_timeout(void);
+void aof_rotate(void);
+void aof_rotate_done(int status);
+void aof_reset(void);
+
+void aof_log_queue_create(Queue_t *queue_t);
+void aof_log_queue_rename(Queue_t *queue_t, const char *name);
+void aof_log_queue_purge(Queue_t *queue_t);
+void aof_log_queue_delete(Queue_t *queue_t);
+void aof_log_message_push(Queue_t *queue_t, Message *msg);
+void aof_log_message_pop(Queue_t *queue_t, Message *msg, uint32_t timeout);
+void aof_log_message_confirm(Queue_t *queue_t, uint64_t tag);
+void aof_log_messages_expire(Queue_t *queue_t, uint32_t time);
+void aof_log_messages_redeliver(Queue_t *queue_t, uint32_t time);
+
+#endif
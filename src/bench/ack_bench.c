@@ -0,0 +1,380 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "protocol.h"
+
+#define BENCH_QUEUE "ack-bench"
+#define BENCH_PIPELINE 1000
+#define BENCH_MESSAGE_SIZE 10
+#define BENCH_POP_TIMEOUT 600000
+#define BENCH_BUF_SIZE 1048576
+
+static int fd;
+static char *buffer;
+static size_t buflen;
+
+static void die(const char *message)
+{
+	fprintf(stderr, "%s\n", message);
+	exit(1);
+}
+
+static double mstime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void send_data(const void *data, size_t length)
+{
+	const char *ptr = data;
+	ssize_t nwritten;
+
+	while (length)
+	{
+		nwritten = write(fd, ptr, length);
+		if (nwritten == -1) {
+			if (errno == EINTR)
+				continue;
+			die("Error write to the server");
+		}
+
+		ptr += nwritten;
+		length -= nwritten;
+	}
+}
+
+static void recv_data(void *data, size_t length)
+{
+	char *ptr = data;
+	ssize_t nread;
+
+	while (length)
+	{
+		nread = read(fd, ptr, length);
+		if (nread <= 0) {
+			if (nread == -1 && errno == EINTR)
+				continue;
+			die("Error read from the server");
+		}
+
+		ptr += nread;
+		length -= nread;
+	}
+}
+
+static void set_header(ProtocolRequestHeader *header, int cmd, int noack, uint32_t bodylen)
+{
+	header->magic = EG_PROTOCOL_REQ;
+	header->cmd = cmd;
+	header->noack = noack;
+	header->bodylen = bodylen;
+}
+
+static void flush_requests(void)
+{
+	send_data(buffer, buflen);
+	buflen = 0;
+}
+
+static void add_request(const void *data, size_t length)
+{
+	if (buflen + length > BENCH_BUF_SIZE) {
+		flush_requests();
+	}
+
+	memcpy(buffer + buflen, data, length);
+	buflen += length;
+}
+
+static int read_response(uint64_t *tag)
+{
+	ProtocolResponseHeader res;
+	char body[256];
+	uint32_t length;
+
+	recv_data(&res, sizeof(res));
+
+	for (length = res.bodylen; length; )
+	{
+		uint32_t chunk = length > sizeof(body) ? sizeof(body) : length;
+
+		recv_data(body, chunk);
+
+		if (tag && length == res.bodylen && chunk >= sizeof(uint64_t)) {
+			memcpy(tag, body, sizeof(uint64_t));
+		}
+
+		length -= chunk;
+	}
+
+	return res.status;
+}
+
+static void call(const void *data, size_t length, int expected)
+{
+	send_data(data, length);
+
+	if (read_response(NULL) != expected) {
+		die("Unexpected response status");
+	}
+}
+
+static void connect_server(const char *host, int port)
+{
+	struct sockaddr_in sa;
+	int on = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd == -1) {
+		die("Error create socket");
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(port);
+
+	if (inet_aton(host, &sa.sin_addr) == 0) {
+		die("Invalid address");
+	}
+
+	if (connect(fd, (struct sockaddr*)&sa, sizeof(sa)) == -1) {
+		die("Error connect to the server");
+	}
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static void prepare_queue(const char *name, const char *password)
+{
+	ProtocolRequestAuth auth;
+	ProtocolRequestQueueCreate create;
+	ProtocolRequestQueueDeclare declare;
+
+	memset(&auth, 0, sizeof(auth));
+	set_header(&auth.header, EG_PROTOCOL_CMD_AUTH, 0, sizeof(auth.body));
+	strncpy(auth.body.name, name, sizeof(auth.body.name) - 1);
+	strncpy(auth.body.password, password, sizeof(auth.body.password) - 1);
+	call(&auth, sizeof(auth), EG_PROTOCOL_STATUS_SUCCESS);
+
+	memset(&create, 0, sizeof(create));
+	set_header(&create.header, EG_PROTOCOL_CMD_QUEUE_CREATE, 0, sizeof(create.body));
+	strcpy(create.body.name, BENCH_QUEUE);
+	create.body.max_msg = 0xFFFFFFFF;
+	send_data(&create, sizeof(create));
+	read_response(NULL);
+
+	memset(&declare, 0, sizeof(declare));
+	set_header(&declare.header, EG_PROTOCOL_CMD_QUEUE_DECLARE, 0, sizeof(declare.body));
+	strcpy(declare.body.name, BENCH_QUEUE);
+	call(&declare, sizeof(declare), EG_PROTOCOL_STATUS_SUCCESS);
+}
+
+static void purge_queue(void)
+{
+	ProtocolRequestQueuePurge purge;
+
+	memset(&purge, 0, sizeof(purge));
+	set_header(&purge.header, EG_PROTOCOL_CMD_QUEUE_PURGE, 0, sizeof(purge.body));
+	strcpy(purge.body.name, BENCH_QUEUE);
+	call(&purge, sizeof(purge), EG_PROTOCOL_STATUS_SUCCESS);
+}
+
+static void push_messages(uint32_t count)
+{
+	char request[sizeof(ProtocolRequestHeader) + 64 + sizeof(uint32_t) + BENCH_MESSAGE_SIZE];
+	ProtocolRequestPing ping;
+	uint32_t i;
+
+	memset(request, 0, sizeof(request));
+	set_header((ProtocolRequestHeader*)request, EG_PROTOCOL_CMD_QUEUE_PUSH, 1, sizeof(request) - sizeof(ProtocolRequestHeader));
+	strcpy(request + sizeof(ProtocolRequestHeader), BENCH_QUEUE);
+	memset(request + sizeof(request) - BENCH_MESSAGE_SIZE, 'x', BENCH_MESSAGE_SIZE);
+
+	for (i = 0; i < count; i++) {
+		add_request(request, sizeof(request));
+	}
+
+	flush_requests();
+
+	set_header(&ping, EG_PROTOCOL_CMD_PING, 0, 0);
+	call(&ping, sizeof(ping), EG_PROTOCOL_STATUS_SUCCESS);
+}
+
+static void pop_messages(uint64_t *tags, uint32_t count)
+{
+	ProtocolRequestQueuePop pop;
+	uint32_t i, j, batch;
+
+	memset(&pop, 0, sizeof(pop));
+	set_header(&pop.header, EG_PROTOCOL_CMD_QUEUE_POP, 0, sizeof(pop.body));
+	strcpy(pop.body.name, BENCH_QUEUE);
+	pop.body.timeout = BENCH_POP_TIMEOUT;
+
+	for (i = 0; i < count; i += batch)
+	{
+		batch = (count - i) < BENCH_PIPELINE ? (count - i) : BENCH_PIPELINE;
+
+		for (j = 0; j < batch; j++) {
+			add_request(&pop, sizeof(pop));
+		}
+
+		flush_requests();
+
+		for (j = 0; j < batch; j++)
+		{
+			if (read_response(&tags[i + j]) != EG_PROTOCOL_STATUS_SUCCESS) {
+				die("Error pop message");
+			}
+		}
+	}
+}
+
+static double confirm_messages(uint64_t *tags, uint32_t count)
+{
+	ProtocolRequestQueueConfirm confirm;
+	uint32_t i, j, batch;
+	double start;
+
+	memset(&confirm, 0, sizeof(confirm));
+	set_header(&confirm.header, EG_PROTOCOL_CMD_QUEUE_CONFIRM, 0, sizeof(confirm.body));
+	strcpy(confirm.body.name, BENCH_QUEUE);
+
+	start = mstime();
+
+	for (i = 0; i < count; i += batch)
+	{
+		batch = (count - i) < BENCH_PIPELINE ? (count - i) : BENCH_PIPELINE;
+
+		for (j = 0; j < batch; j++)
+		{
+			confirm.body.tag = tags[i + j];
+			add_request(&confirm, sizeof(confirm));
+		}
+
+		flush_requests();
+
+		for (j = 0; j < batch; j++)
+		{
+			if (read_response(NULL) != EG_PROTOCOL_STATUS_SUCCESS) {
+				die("Error confirm message");
+			}
+		}
+	}
+
+	return mstime() - start;
+}
+
+static void shuffle_tags(uint64_t *tags, uint32_t count)
+{
+	uint64_t tag;
+	uint32_t i, j;
+
+	srand(1);
+
+	for (i = count - 1; i > 0; i--)
+	{
+		j = rand() % (i + 1);
+		tag = tags[i];
+		tags[i] = tags[j];
+		tags[j] = tag;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t counts[] = {1000, 10000, 100000};
+	uint32_t count, i, rounds = sizeof(counts) / sizeof(counts[0]);
+	const char *host = getenv("EAGLEMQ_HOST");
+	const char *port = getenv("EAGLEMQ_PORT");
+	uint64_t *tags;
+	double elapsed;
+	int repeat, repeats = 5;
+
+	if (argc > 1)
+	{
+		rounds = argc - 1;
+		for (i = 0; i < rounds && i < sizeof(counts) / sizeof(counts[0]); i++) {
+			counts[i] = strtoul(argv[i + 1], NULL, 10);
+		}
+		rounds = i;
+	}
+
+	buffer = malloc(BENCH_BUF_SIZE);
+
+	connect_server(host ? host : "127.0.0.1", port ? atoi(port) : 7851);
+	prepare_queue("eagle", "eagle");
+
+	printf("%10s %16s\n", "in flight", "confirms/s");
+
+	for (i = 0; i < rounds; i++)
+	{
+		count = counts[i];
+		tags = malloc(count * sizeof(uint64_t));
+		elapsed = 0;
+
+		for (repeat = 0; repeat < repeats; repeat++)
+		{
+			double time;
+
+			purge_queue();
+			push_messages(count);
+			pop_messages(tags, count);
+			shuffle_tags(tags, count);
+
+			time = confirm_messages(tags, count);
+			if (repeat == 0 || time < elapsed) {
+				elapsed = time;
+			}
+		}
+
+		printf("%10u %16.0f\n", count, count / (elapsed / 1e3));
+
+		free(tags);
+	}
+
+	purge_queue();
+
+	return 0;
+}
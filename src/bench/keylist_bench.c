@@ -0,0 +1,149 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "keylist.h"
+#include "dict.h"
+
+#define BENCH_KEY_SIZE 32
+
+void fatal(const char *fmt,...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+
+	exit(1);
+}
+
+static int match_string_handler(void *key1, void *key2)
+{
+	return !strcmp(key1, key2);
+}
+
+static double nstime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static KeylistNode *scan_keylist(Keylist *keylist, void *key)
+{
+	KeylistIterator iterator;
+	KeylistNode *node;
+
+	keylist_rewind(keylist, &iterator);
+	while ((node = keylist_next_node(&iterator)) != NULL)
+	{
+		if (keylist->match(EG_KEYLIST_NODE_KEY(node), key))
+			return node;
+	}
+
+	return NULL;
+}
+
+static double bench_lookup(Keylist *keylist, int keys, int lookups, int scan)
+{
+	char key[BENCH_KEY_SIZE];
+	double start;
+	long found = 0;
+	int i;
+
+	start = nstime();
+
+	for (i = 0; i < lookups; i++)
+	{
+		snprintf(key, sizeof(key), "route.key.%d", (int)((i * 7919L) % keys));
+
+		if (scan) {
+			found += scan_keylist(keylist, key) != NULL;
+		} else {
+			found += keylist_get_value(keylist, key) != NULL;
+		}
+	}
+
+	if (found != lookups) {
+		fprintf(stderr, "Lost keys: %ld of %d found\n", found, lookups);
+		exit(1);
+	}
+
+	return (nstime() - start) / lookups;
+}
+
+int main(int argc, char *argv[])
+{
+	int sizes[] = {10, 100, 1000, 10000, 100000};
+	int count = sizeof(sizes) / sizeof(sizes[0]);
+	int i, j, keys, lookups;
+	Keylist *keylist;
+	char *key;
+	double scan, hash;
+
+	if (argc > 1) {
+		count = 1;
+		sizes[0] = atoi(argv[1]);
+	}
+
+	printf("%10s %16s %16s\n", "keys", "scan ns/lookup", "hash ns/lookup");
+
+	for (i = 0; i < count; i++)
+	{
+		keys = sizes[i];
+		keylist = keylist_create();
+
+		EG_KEYLIST_SET_HASH_METHOD(keylist, dict_string_hash);
+		EG_KEYLIST_SET_MATCH_METHOD(keylist, match_string_handler);
+
+		for (j = 0; j < keys; j++)
+		{
+			key = malloc(BENCH_KEY_SIZE);
+			snprintf(key, BENCH_KEY_SIZE, "route.key.%d", j);
+			keylist_set_value(keylist, key, key);
+		}
+
+		lookups = keys >= 10000 ? 2000 : 200000;
+
+		scan = bench_lookup(keylist, keys, lookups, 1);
+		hash = bench_lookup(keylist, keys, keys >= 10000 ? 200000 : lookups, 0);
+
+		printf("%10d %16.1f %16.1f\n", keys, scan, hash);
+	}
+
+	return 0;
+}
@@ -0,0 +1,318 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "queue.h"
+#include "xmalloc.h"
+
+#define BENCH_MESSAGES 1000000
+#define BENCH_DEPTH 1024
+#define BENCH_EXPIRING 64
+
+typedef struct BenchNode {
+	struct BenchNode *prev;
+	struct BenchNode *next;
+	void *value;
+} BenchNode;
+
+typedef struct BenchList {
+	BenchNode *head;
+	BenchNode *tail;
+	unsigned int len;
+} BenchList;
+
+typedef struct BenchItem {
+	uint64_t position;
+	BenchNode *node;
+} BenchItem;
+
+static BenchItem items[BENCH_EXPIRING + 1];
+
+void fatal(const char *fmt,...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+
+	exit(1);
+}
+
+static double nstime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static BenchNode *list_push_head(BenchList *list, void *value)
+{
+	BenchNode *node;
+
+	node = (BenchNode*)xmalloc(sizeof(*node));
+
+	node->value = value;
+	node->prev = NULL;
+	node->next = list->head;
+
+	if (list->head) {
+		list->head->prev = node;
+	} else {
+		list->tail = node;
+	}
+
+	list->head = node;
+	list->len++;
+
+	return node;
+}
+
+static void list_delete_node(BenchList *list, BenchNode *node)
+{
+	if (node->prev) {
+		node->prev->next = node->next;
+	} else {
+		list->head = node->next;
+	}
+
+	if (node->next) {
+		node->next->prev = node->prev;
+	} else {
+		list->tail = node->prev;
+	}
+
+	xfree(node);
+	list->len--;
+}
+
+static void *list_pop_tail(BenchList *list)
+{
+	void *value;
+
+	if (!list->len) {
+		return NULL;
+	}
+
+	value = list->tail->value;
+	list_delete_node(list, list->tail);
+
+	return value;
+}
+
+static void index_item_handler(void *value, uint64_t position)
+{
+	((BenchItem*)value)->position = position;
+}
+
+static double bench_list_fill(void)
+{
+	BenchList list = {NULL, NULL, 0};
+	double start = nstime();
+	long i;
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		list_push_head(&list, &items[0]);
+	}
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		list_pop_tail(&list);
+	}
+
+	return (nstime() - start) / BENCH_MESSAGES;
+}
+
+static double bench_queue_fill(void)
+{
+	Queue *queue = queue_create();
+	double start = nstime(), elapsed;
+	long i;
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		queue_push_value_head(queue, &items[0]);
+	}
+
+	for (i = 0; i < BENCH_MESSAGES; i++) {
+		queue_pop_value(queue);
+	}
+
+	elapsed = (nstime() - start) / BENCH_MESSAGES;
+
+	queue_release(queue);
+
+	return elapsed;
+}
+
+static double bench_list_depth(void)
+{
+	BenchList list = {NULL, NULL, 0};
+	double start, elapsed;
+	long i;
+
+	for (i = 0; i < BENCH_DEPTH; i++) {
+		list_push_head(&list, &items[0]);
+	}
+
+	start = nstime();
+
+	for (i = 0; i < BENCH_MESSAGES; i++)
+	{
+		list_push_head(&list, &items[0]);
+		list_pop_tail(&list);
+	}
+
+	elapsed = (nstime() - start) / BENCH_MESSAGES;
+
+	while (list.len) {
+		list_pop_tail(&list);
+	}
+
+	return elapsed;
+}
+
+static double bench_queue_depth(void)
+{
+	Queue *queue = queue_create();
+	double start, elapsed;
+	long i;
+
+	for (i = 0; i < BENCH_DEPTH; i++) {
+		queue_push_value_head(queue, &items[0]);
+	}
+
+	start = nstime();
+
+	for (i = 0; i < BENCH_MESSAGES; i++)
+	{
+		queue_push_value_head(queue, &items[0]);
+		queue_pop_value(queue);
+	}
+
+	elapsed = (nstime() - start) / BENCH_MESSAGES;
+
+	queue_release(queue);
+
+	return elapsed;
+}
+
+static double bench_list_expire(void)
+{
+	BenchList list = {NULL, NULL, 0};
+	BenchItem *item;
+	double start, elapsed;
+	long i;
+
+	list_push_head(&list, &items[BENCH_EXPIRING]);
+
+	start = nstime();
+
+	for (i = 0; i < BENCH_MESSAGES; i++)
+	{
+		item = &items[i % BENCH_EXPIRING];
+
+		if (i >= BENCH_EXPIRING) {
+			list_delete_node(&list, item->node);
+		}
+
+		item->node = list_push_head(&list, item);
+	}
+
+	elapsed = (nstime() - start) / BENCH_MESSAGES;
+
+	while (list.len) {
+		list_pop_tail(&list);
+	}
+
+	return elapsed;
+}
+
+static double bench_queue_expire(unsigned long *size)
+{
+	Queue *queue = queue_create();
+	BenchItem *item;
+	double start, elapsed;
+	long i;
+
+	EG_QUEUE_SET_INDEX_METHOD(queue, index_item_handler);
+
+	queue_push_value_head(queue, &items[BENCH_EXPIRING]);
+
+	start = nstime();
+
+	for (i = 0; i < BENCH_MESSAGES; i++)
+	{
+		item = &items[i % BENCH_EXPIRING];
+
+		if (i >= BENCH_EXPIRING) {
+			queue_delete_position(queue, item->position);
+		}
+
+		queue_push_value_head(queue, item);
+		item->position = EG_QUEUE_FIRST(queue);
+	}
+
+	elapsed = (nstime() - start) / BENCH_MESSAGES;
+
+	*size = queue->size;
+
+	queue_release(queue);
+
+	return elapsed;
+}
+
+int main(void)
+{
+	unsigned long size;
+	double list, ring;
+
+	printf("%-40s %10s %10s\n", "ns/msg", "linked", "ring");
+
+	list = bench_list_fill();
+	ring = bench_queue_fill();
+	printf("%-40s %10.1f %10.1f\n", "1M push then 1M pop", list, ring);
+
+	list = bench_list_depth();
+	ring = bench_queue_depth();
+	printf("%-40s %10.1f %10.1f\n", "push+pop at depth 1024", list, ring);
+
+	list = bench_list_expire();
+	ring = bench_queue_expire(&size);
+	printf("%-40s %10.1f %10.1f\n", "push+expire behind a long-lived message", list, ring);
+
+	printf("ring slots after 1M expiring pushes: %lu\n", size);
+
+	return 0;
+}
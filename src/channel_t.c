@@ -33,9 +33,18 @@
 #include "handlers.h"
 #include "protocol.h"
 #include "keylist.h"
+#include "dict.h"
+#include "pattern.h"
 #include "xmalloc.h"
 #include "utils.h"
 
+typedef struct ChannelMessage {
+	Channel_t *channel;
+	const char *topic;
+	Object *msg;
+} ChannelMessage;
+
+static void publish_pattern_message_channel_t(void *value, void *data);
 static void eject_clients_channel_t(Channel_t *channel);
 
 static void free_channel_keylist_handler(void *key, void *value);
@@ -61,10 +70,13 @@ Channel_t *create_channel_t(const char *name, uint32_t flags)
 
 	channel->topics = keylist_create();
 	channel->patterns = keylist_create();
+	channel->pattern_trie = pattern_trie_create();
 
+	EG_KEYLIST_SET_HASH_METHOD(channel->topics, dict_string_hash);
 	EG_KEYLIST_SET_FREE_METHOD(channel->topics, free_channel_keylist_handler);
 	EG_KEYLIST_SET_MATCH_METHOD(channel->topics, match_channel_keylist_handler);
 
+	EG_KEYLIST_SET_HASH_METHOD(channel->patterns, dict_string_hash);
 	EG_KEYLIST_SET_FREE_METHOD(channel->patterns, free_channel_keylist_handler);
 	EG_KEYLIST_SET_MATCH_METHOD(channel->patterns, match_channel_keylist_handler);
 
@@ -77,19 +89,19 @@ void delete_channel_t(Channel_t *channel)
 
 	keylist_release(channel->topics);
 	keylist_release(channel->patterns);
+	pattern_trie_release(channel->pattern_trie);
 
 	xfree(channel);
 }
 
 void publish_message_channel_t(Channel_t *channel, const char *topic, Object *msg)
 {
+	ChannelMessage message;
 	EagleClient *client;
-	KeylistIterator keylist_iterator;
 	KeylistNode *keylist_node;
 	ListNode *list_node;
 	ListIterator list_iterator;
 	List *list;
-	char *pattern;
 
 	keylist_node = keylist_get_value(channel->topics, (void*)topic);
 	if (keylist_node)
@@ -116,47 +128,69 @@ void publish_message_channel_t(Channel_t *channel, const char *topic, Object *ms
 
 	if (EG_KEYLIST_LENGTH(channel->patterns))
 	{
-		keylist_rewind(channel->patterns, &keylist_iterator);
-		while ((keylist_node = keylist_next_node(&keylist_iterator)) != NULL)
-		{
-			pattern = EG_KEYLIST_NODE_KEY(keylist_node);
+		message.channel = channel;
+		message.topic = topic;
+		message.msg = msg;
 
-			if (pattern_match(topic, pattern, 0))
-			{
-				list = EG_KEYLIST_NODE_VALUE(keylist_node);
-
-				list_rewind(list, &list_iterator);
-				while ((list_node = list_next_node(&list_iterator)) != NULL)
-				{
-					client = EG_LIST_NODE_VALUE(list_node);
-					channel_client_event_pattern_message(client, channel, topic, pattern, msg);
-				}
-			}
-		}
+		pattern_trie_match(channel->pattern_trie, topic, publish_pattern_message_channel_t, &message);
 	}
 }
 
-Channel_t *find_channel_t(List *list, const char *name)
+static void publish_pattern_message_channel_t(void *value, void *data)
 {
-	Channel_t *channel;
-	ListNode *node;
-	ListIterator iterator;
+	ChannelMessage *message = data;
+	KeylistNode *keylist_node = value;
+	ListNode *list_node;
+	ListIterator list_iterator;
+	EagleClient *client;
 
-	list_rewind(list, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
+	list_rewind(EG_KEYLIST_NODE_VALUE(keylist_node), &list_iterator);
+	while ((list_node = list_next_node(&list_iterator)) != NULL)
 	{
-		channel = EG_LIST_NODE_VALUE(node);
-		if (!strcmp(channel->name, name)) {
-			return channel;
-		}
+		client = EG_LIST_NODE_VALUE(list_node);
+		channel_client_event_pattern_message(client, message->channel, message->topic,
+			EG_KEYLIST_NODE_KEY(keylist_node), message->msg);
 	}
+}
 
-	return NULL;
+void register_channel_t(Channel_t *channel)
+{
+	list_add_value_tail(server->channels, channel);
+	dict_add(server->channel_index, channel->name, EG_LIST_LAST(server->channels));
+}
+
+int unregister_channel_t(Channel_t *channel)
+{
+	ListNode *node = dict_fetch_value(server->channel_index, channel->name);
+
+	if (!node || EG_LIST_NODE_VALUE(node) != channel) {
+		return EG_STATUS_ERR;
+	}
+
+	dict_delete(server->channel_index, channel->name);
+	list_delete_node(server->channels, node);
+
+	return EG_STATUS_OK;
+}
+
+Channel_t *find_channel_t(const char *name)
+{
+	ListNode *node = dict_fetch_value(server->channel_index, (void*)name);
+
+	return node ? EG_LIST_NODE_VALUE(node) : NULL;
 }
 
 void rename_channel_t(Channel_t *channel, const char *name)
 {
+	ListNode *node = dict_fetch_value(server->channel_index, channel->name);
+
+	dict_delete(server->channel_index, channel->name);
+
 	memcpy(channel->name, name, strlenz(name));
+
+	if (node) {
+		dict_add(server->channel_index, channel->name, node);
+	}
 }
 
 static void add_keylist_channel_t(Keylist *keylist, Channel_t *channel, KeylistNode *keylist_node)
@@ -242,6 +276,7 @@ void psubscribe_channel_t(Channel_t *channel, EagleClient *client, const char *p
 		list = list_create();
 		keylist_set_value(channel->patterns, xstrdup(pattern), list);
 		node = EG_KEYLIST_LAST(channel->patterns);
+		pattern_trie_insert(channel->pattern_trie, EG_KEYLIST_NODE_KEY(node), node);
 		subscribe = 1;
 	}
 	else
@@ -280,7 +315,7 @@ int unsubscribe_channel_t(Channel_t *channel, EagleClient *client, const char *t
 	{
 		if (EG_KEYLIST_LENGTH(channel->topics) == 0 &&
 			EG_KEYLIST_LENGTH(channel->patterns) == 0) {
-			list_delete_value(server->channels, channel);
+			unregister_channel_t(channel);
 		}
 	}
 
@@ -302,6 +337,7 @@ int punsubscribe_channel_t(Channel_t *channel, EagleClient *client, const char *
 	remove_keylist_channel_t(client->subscribed_patterns, channel, node);
 
 	if (!EG_LIST_LENGTH(list)) {
+		pattern_trie_delete(channel->pattern_trie, EG_KEYLIST_NODE_KEY(node), node);
 		keylist_delete_node(channel->patterns, node);
 	}
 
@@ -309,7 +345,7 @@ int punsubscribe_channel_t(Channel_t *channel, EagleClient *client, const char *
 	{
 		if (EG_KEYLIST_LENGTH(channel->topics) == 0 &&
 			EG_KEYLIST_LENGTH(channel->patterns) == 0) {
-			list_delete_value(server->channels, channel);
+			unregister_channel_t(channel);
 		}
 	}
 
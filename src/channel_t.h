@@ -34,7 +34,9 @@
 Channel_t *create_channel_t(const char *name, uint32_t flags);
 void delete_channel_t(Channel_t *channel);
 void publish_message_channel_t(Channel_t *channel, const char *topic, Object *msg);
-Channel_t *find_channel_t(List *list, const char *name);
+void register_channel_t(Channel_t *channel);
+int unregister_channel_t(Channel_t *channel);
+Channel_t *find_channel_t(const char *name);
 void rename_channel_t(Channel_t *channel, const char *name);
 void subscribe_channel_t(Channel_t *channel, EagleClient *client, const char *topic);
 void psubscribe_channel_t(Channel_t *channel, EagleClient *client, const char *pattern);
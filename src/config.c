@@ -31,6 +31,7 @@
 
 #include "eagle.h"
 #include "config.h"
+#include "storage.h"
 #include "xmalloc.h"
 #include "utils.h"
 
@@ -52,10 +53,36 @@ static int parse_on_off(char *value)
 	return result;
 }
 
+static int parse_aof_fsync(char *value)
+{
+	if (!strcmp(value, "always"))
+		return EG_AOF_FSYNC_ALWAYS;
+
+	if (!strcmp(value, "everysec"))
+		return EG_AOF_FSYNC_EVERYSEC;
+
+	if (!strcmp(value, "never"))
+		return EG_AOF_FSYNC_NEVER;
+
+	return EG_STATUS_ERR;
+}
+
+static int parse_save_mode(char *value)
+{
+	if (!strcmp(value, "fork"))
+		return EG_SAVE_MODE_FORK;
+
+	if (!strcmp(value, "incremental"))
+		return EG_SAVE_MODE_INCREMENTAL;
+
+	return EG_STATUS_ERR;
+}
+
 int config_parse_key_value(char *key, char *value)
 {
 	int err;
 	long long max_memory;
+	long long max_request_size;
 
 	if (!strcmp(key, "addr")) {
 		set_value_string(&server->addr, value);
@@ -75,16 +102,32 @@ int config_parse_key_value(char *key, char *value)
 		set_value_string(&server->logfile, value);
 	} else if (!strcmp(key, "storage-file")) {
 		set_value_string(&server->storage, value);
+	} else if (!strcmp(key, "aof")) {
+		server->aof = parse_on_off(value);
+	} else if (!strcmp(key, "aof-file")) {
+		set_value_string(&server->aof_file, value);
+	} else if (!strcmp(key, "aof-fsync")) {
+		if ((server->aof_fsync = parse_aof_fsync(value)) == EG_STATUS_ERR) return EG_STATUS_ERR;
 	} else if (!strcmp(key, "max-clients")) {
 		server->max_clients = atoi(value);
 	} else if (!strcmp(key, "max-memory")) {
 		max_memory = memtoll(value, &err);
 		if (err) return EG_STATUS_ERR;
 		server->max_memory = max_memory;
+	} else if (!strcmp(key, "max-request-size")) {
+		max_request_size = memtoll(value, &err);
+		if (err) return EG_STATUS_ERR;
+		server->max_request_size = max_request_size;
 	} else if (!strcmp(key, "save-timeout")) {
 		server->storage_timeout = atoi(value);
+	} else if (!strcmp(key, "save-mode")) {
+		if ((server->save_mode = parse_save_mode(value)) == EG_STATUS_ERR) return EG_STATUS_ERR;
+	} else if (!strcmp(key, "storage-compression")) {
+		if ((server->storage_codec = storage_find_codec(value)) == EG_STATUS_ERR) return EG_STATUS_ERR;
 	} else if (!strcmp(key, "client-timeout")) {
 		server->client_timeout = atoi(value);
+	} else if (!strcmp(key, "edge-triggered")) {
+		server->edge_triggered = parse_on_off(value);
 	} else {
 		info("Error parse key: %s", key);
 		return EG_STATUS_ERR;
@@ -0,0 +1,525 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "eagle.h"
+#include "dict.h"
+#include "xmalloc.h"
+
+static void dict_reset_table(DictTable *table);
+static void dict_clear_table(Dict *dict, DictTable *table);
+static unsigned long dict_next_power(unsigned long size);
+static void dict_expand_if_needed(Dict *dict);
+static void dict_shrink_if_needed(Dict *dict);
+static DictEntry **dict_find_link(Dict *dict, void *key, DictTable **found);
+
+#define dict_hash_key(d, k) ((d)->hash ? (d)->hash(k) : dict_pointer_hash(k))
+#define dict_match_keys(d, k1, k2) ((d)->match ? (d)->match(k1, k2) : (k1) == (k2))
+
+Dict *dict_create(void)
+{
+	Dict *dict;
+
+	dict = (Dict*)xmalloc(sizeof(*dict));
+
+	dict_reset_table(&dict->table[0]);
+	dict_reset_table(&dict->table[1]);
+
+	dict->rehashidx = -1;
+	dict->iterators = 0;
+	dict->hash = NULL;
+	dict->free = NULL;
+	dict->match = NULL;
+
+	return dict;
+}
+
+void dict_release(Dict *dict)
+{
+	dict_clear_table(dict, &dict->table[0]);
+	dict_clear_table(dict, &dict->table[1]);
+
+	xfree(dict);
+}
+
+void dict_empty(Dict *dict)
+{
+	dict_clear_table(dict, &dict->table[0]);
+	dict_clear_table(dict, &dict->table[1]);
+
+	dict->rehashidx = -1;
+}
+
+int dict_add(Dict *dict, void *key, void *value)
+{
+	DictTable *table;
+	DictEntry *entry;
+	unsigned long index;
+
+	if (EG_DICT_IS_REHASHING(dict)) {
+		dict_rehash(dict, EG_DICT_REHASH_STEPS);
+	}
+
+	if (dict_find_link(dict, key, NULL)) {
+		return EG_STATUS_ERR;
+	}
+
+	dict_expand_if_needed(dict);
+
+	table = EG_DICT_IS_REHASHING(dict) ? &dict->table[1] : &dict->table[0];
+	index = dict_hash_key(dict, key) & table->sizemask;
+
+	entry = (DictEntry*)xmalloc(sizeof(*entry));
+
+	entry->key = key;
+	entry->value = value;
+	entry->next = table->table[index];
+
+	table->table[index] = entry;
+	table->used++;
+
+	return EG_STATUS_OK;
+}
+
+int dict_set_value(Dict *dict, void *key, void *value)
+{
+	DictEntry *entry;
+
+	if (dict_add(dict, key, value) == EG_STATUS_OK) {
+		return EG_STATUS_OK;
+	}
+
+	entry = dict_find(dict, key);
+	entry->value = value;
+
+	return EG_STATUS_OK;
+}
+
+DictEntry *dict_find(Dict *dict, void *key)
+{
+	DictEntry **link;
+
+	if (EG_DICT_LENGTH(dict) == 0) {
+		return NULL;
+	}
+
+	if (EG_DICT_IS_REHASHING(dict)) {
+		dict_rehash(dict, EG_DICT_REHASH_STEPS);
+	}
+
+	link = dict_find_link(dict, key, NULL);
+
+	return link ? *link : NULL;
+}
+
+void *dict_fetch_value(Dict *dict, void *key)
+{
+	DictEntry *entry = dict_find(dict, key);
+
+	return entry ? entry->value : NULL;
+}
+
+int dict_delete(Dict *dict, void *key)
+{
+	DictTable *table;
+	DictEntry **link;
+	DictEntry *entry;
+
+	if (EG_DICT_LENGTH(dict) == 0) {
+		return EG_STATUS_ERR;
+	}
+
+	if (EG_DICT_IS_REHASHING(dict)) {
+		dict_rehash(dict, EG_DICT_REHASH_STEPS);
+	}
+
+	link = dict_find_link(dict, key, &table);
+	if (!link) {
+		return EG_STATUS_ERR;
+	}
+
+	entry = *link;
+	*link = entry->next;
+	table->used--;
+
+	if (dict->free) {
+		dict->free(entry->key, entry->value);
+	}
+
+	xfree(entry);
+
+	dict_shrink_if_needed(dict);
+
+	return EG_STATUS_OK;
+}
+
+int dict_expand(Dict *dict, unsigned long size)
+{
+	DictTable table;
+	unsigned long realsize = dict_next_power(size);
+
+	if (EG_DICT_IS_REHASHING(dict) || dict->table[0].used > size || realsize == dict->table[0].size) {
+		return EG_STATUS_ERR;
+	}
+
+	table.size = realsize;
+	table.sizemask = realsize - 1;
+	table.table = (DictEntry**)xcalloc(realsize * sizeof(DictEntry*));
+	table.used = 0;
+
+	if (dict->table[0].table == NULL) {
+		dict->table[0] = table;
+		return EG_STATUS_OK;
+	}
+
+	dict->table[1] = table;
+	dict->rehashidx = 0;
+
+	return EG_STATUS_OK;
+}
+
+int dict_rehash(Dict *dict, int steps)
+{
+	DictEntry *entry, *next;
+	unsigned long index;
+	int empty_visits = steps * 10;
+
+	if (!EG_DICT_IS_REHASHING(dict) || dict->iterators) {
+		return 0;
+	}
+
+	while (steps-- && dict->table[0].used != 0)
+	{
+		while (dict->table[0].table[dict->rehashidx] == NULL)
+		{
+			dict->rehashidx++;
+			if (--empty_visits == 0) {
+				return 1;
+			}
+		}
+
+		entry = dict->table[0].table[dict->rehashidx];
+
+		while (entry)
+		{
+			next = entry->next;
+
+			index = dict_hash_key(dict, entry->key) & dict->table[1].sizemask;
+			entry->next = dict->table[1].table[index];
+			dict->table[1].table[index] = entry;
+
+			dict->table[0].used--;
+			dict->table[1].used++;
+
+			entry = next;
+		}
+
+		dict->table[0].table[dict->rehashidx] = NULL;
+		dict->rehashidx++;
+	}
+
+	if (dict->table[0].used == 0)
+	{
+		xfree(dict->table[0].table);
+		dict->table[0] = dict->table[1];
+		dict_reset_table(&dict->table[1]);
+		dict->rehashidx = -1;
+		return 0;
+	}
+
+	return 1;
+}
+
+DictIterator *dict_get_iterator(Dict *dict)
+{
+	DictIterator *iter;
+
+	iter = (DictIterator*)xmalloc(sizeof(*iter));
+
+	iter->dict = dict;
+	iter->table = 0;
+	iter->index = -1;
+	iter->entry = NULL;
+	iter->next = NULL;
+
+	dict->iterators++;
+
+	return iter;
+}
+
+void dict_release_iterator(DictIterator *iter)
+{
+	iter->dict->iterators--;
+
+	xfree(iter);
+}
+
+DictEntry *dict_next_entry(DictIterator *iter)
+{
+	DictTable *table;
+
+	while (1)
+	{
+		if (iter->entry == NULL)
+		{
+			table = &iter->dict->table[iter->table];
+
+			iter->index++;
+
+			if (iter->index >= (long)table->size)
+			{
+				if (EG_DICT_IS_REHASHING(iter->dict) && iter->table == 0) {
+					iter->table++;
+					iter->index = 0;
+					table = &iter->dict->table[1];
+				} else {
+					break;
+				}
+			}
+
+			if (table->table == NULL) {
+				break;
+			}
+
+			iter->entry = table->table[iter->index];
+		}
+		else
+		{
+			iter->entry = iter->next;
+		}
+
+		if (iter->entry)
+		{
+			iter->next = iter->entry->next;
+			return iter->entry;
+		}
+	}
+
+	return NULL;
+}
+
+unsigned int dict_gen_hash_function(const void *key, int length)
+{
+	const uint32_t m = 0x5bd1e995;
+	const int r = 24;
+	const unsigned char *data = (const unsigned char*)key;
+	uint32_t h = 5381 ^ length;
+	uint32_t k;
+
+	while (length >= 4)
+	{
+		k = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h *= m;
+		h ^= k;
+
+		data += 4;
+		length -= 4;
+	}
+
+	switch (length)
+	{
+		case 3: h ^= data[2] << 16;
+		case 2: h ^= data[1] << 8;
+		case 1: h ^= data[0]; h *= m;
+	};
+
+	h ^= h >> 13;
+	h *= m;
+	h ^= h >> 15;
+
+	return (unsigned int)h;
+}
+
+unsigned int dict_string_hash(const void *key)
+{
+	return dict_gen_hash_function(key, strlen((const char*)key));
+}
+
+unsigned int dict_pointer_hash(const void *key)
+{
+	uintptr_t value = (uintptr_t)key;
+
+	value = (~value) + (value << 21);
+	value = value ^ (value >> 24);
+	value = (value + (value << 3)) + (value << 8);
+	value = value ^ (value >> 14);
+	value = (value + (value << 2)) + (value << 4);
+	value = value ^ (value >> 28);
+	value = value + (value << 31);
+
+	return (unsigned int)value;
+}
+
+unsigned int dict_uint64_hash(const void *key)
+{
+	uint64_t value = *(const uint64_t*)key;
+
+	value = (~value) + (value << 21);
+	value = value ^ (value >> 24);
+	value = (value + (value << 3)) + (value << 8);
+	value = value ^ (value >> 14);
+	value = (value + (value << 2)) + (value << 4);
+	value = value ^ (value >> 28);
+	value = value + (value << 31);
+
+	return (unsigned int)value;
+}
+
+int dict_string_match(void *key1, void *key2)
+{
+	return !strcmp(key1, key2);
+}
+
+int dict_uint64_match(void *key1, void *key2)
+{
+	return *(uint64_t*)key1 == *(uint64_t*)key2;
+}
+
+static void dict_reset_table(DictTable *table)
+{
+	table->table = NULL;
+	table->size = 0;
+	table->sizemask = 0;
+	table->used = 0;
+}
+
+static void dict_clear_table(Dict *dict, DictTable *table)
+{
+	DictEntry *entry, *next;
+	unsigned long i;
+
+	for (i = 0; i < table->size && table->used > 0; i++)
+	{
+		entry = table->table[i];
+
+		while (entry)
+		{
+			next = entry->next;
+
+			if (dict->free) {
+				dict->free(entry->key, entry->value);
+			}
+
+			xfree(entry);
+			table->used--;
+
+			entry = next;
+		}
+	}
+
+	if (table->table) {
+		xfree(table->table);
+	}
+
+	dict_reset_table(table);
+}
+
+static unsigned long dict_next_power(unsigned long size)
+{
+	unsigned long i = EG_DICT_INITIAL_SIZE;
+
+	while (i < size) {
+		i *= 2;
+	}
+
+	return i;
+}
+
+static void dict_expand_if_needed(Dict *dict)
+{
+	if (EG_DICT_IS_REHASHING(dict)) {
+		return;
+	}
+
+	if (dict->table[0].size == 0) {
+		dict_expand(dict, EG_DICT_INITIAL_SIZE);
+	} else if (dict->table[0].used >= dict->table[0].size) {
+		dict_expand(dict, dict->table[0].used * 2);
+	}
+}
+
+static void dict_shrink_if_needed(Dict *dict)
+{
+	unsigned long used = dict->table[0].used;
+
+	if (EG_DICT_IS_REHASHING(dict) || dict->iterators) {
+		return;
+	}
+
+	if (dict->table[0].size > EG_DICT_INITIAL_SIZE && used * 10 < dict->table[0].size) {
+		dict_expand(dict, used);
+	}
+}
+
+static DictEntry **dict_find_link(Dict *dict, void *key, DictTable **found)
+{
+	DictTable *table;
+	DictEntry **link;
+	unsigned int hash;
+	int i;
+
+	hash = dict_hash_key(dict, key);
+
+	for (i = 0; i <= 1; i++)
+	{
+		table = &dict->table[i];
+
+		if (table->table == NULL) {
+			break;
+		}
+
+		link = &table->table[hash & table->sizemask];
+
+		while (*link)
+		{
+			if (dict_match_keys(dict, (*link)->key, key))
+			{
+				if (found) {
+					*found = table;
+				}
+
+				return link;
+			}
+
+			link = &(*link)->next;
+		}
+
+		if (!EG_DICT_IS_REHASHING(dict)) {
+			break;
+		}
+	}
+
+	return NULL;
+}
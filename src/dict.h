@@ -0,0 +1,97 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __DICT_LIB_H__
+#define __DICT_LIB_H__
+
+#define EG_DICT_INITIAL_SIZE 4
+#define EG_DICT_REHASH_STEPS 1
+
+#define EG_DICT_LENGTH(d) ((d)->table[0].used + (d)->table[1].used)
+#define EG_DICT_IS_REHASHING(d) ((d)->rehashidx != -1)
+#define EG_DICT_ENTRY_KEY(e) ((e)->key)
+#define EG_DICT_ENTRY_VALUE(e) ((e)->value)
+
+#define EG_DICT_SET_HASH_METHOD(d, m) ((d)->hash = (m))
+#define EG_DICT_SET_FREE_METHOD(d, m) ((d)->free = (m))
+#define EG_DICT_SET_MATCH_METHOD(d, m) ((d)->match = (m))
+
+#define EG_DICT_GET_HASH_METHOD(d) ((d)->hash)
+#define EG_DICT_GET_FREE_METHOD(d) ((d)->free)
+#define EG_DICT_GET_MATCH_METHOD(d) ((d)->match)
+
+typedef struct DictEntry {
+	void *key;
+	void *value;
+	struct DictEntry *next;
+} DictEntry;
+
+typedef struct DictTable {
+	DictEntry **table;
+	unsigned long size;
+	unsigned long sizemask;
+	unsigned long used;
+} DictTable;
+
+typedef struct Dict {
+	DictTable table[2];
+	long rehashidx;
+	int iterators;
+	unsigned int (*hash)(const void *key);
+	void (*free)(void *key, void *value);
+	int (*match)(void *key1, void *key2);
+} Dict;
+
+typedef struct DictIterator {
+	Dict *dict;
+	int table;
+	long index;
+	DictEntry *entry;
+	DictEntry *next;
+} DictIterator;
+
+Dict *dict_create(void);
+void dict_release(Dict *dict);
+void dict_empty(Dict *dict);
+int dict_add(Dict *dict, void *key, void *value);
+int dict_set_value(Dict *dict, void *key, void *value);
+DictEntry *dict_find(Dict *dict, void *key);
+void *dict_fetch_value(Dict *dict, void *key);
+int dict_delete(Dict *dict, void *key);
+int dict_expand(Dict *dict, unsigned long size);
+int dict_rehash(Dict *dict, int steps);
+DictIterator *dict_get_iterator(Dict *dict);
+void dict_release_iterator(DictIterator *iter);
+DictEntry *dict_next_entry(DictIterator *iter);
+unsigned int dict_gen_hash_function(const void *key, int length);
+unsigned int dict_string_hash(const void *key);
+unsigned int dict_pointer_hash(const void *key);
+unsigned int dict_uint64_hash(const void *key);
+int dict_string_match(void *key1, void *key2);
+int dict_uint64_match(void *key1, void *key2);
+
+#endif
@@ -61,6 +61,7 @@
 #include "route_t.h"
 #include "channel_t.h"
 #include "storage.h"
+#include "aof.h"
 #include "config.h"
 
 EagleServer *server;
@@ -219,6 +220,9 @@ void init_commands()
 	commands[EG_PROTOCOL_CMD_QUEUE_UNSUBSCRIBE] = queue_unsubscribe_command_handler;
 	commands[EG_PROTOCOL_CMD_QUEUE_PURGE] = queue_purge_command_handler;
 	commands[EG_PROTOCOL_CMD_QUEUE_DELETE] = queue_delete_command_handler;
+	commands[EG_PROTOCOL_CMD_QUEUE_PUSH_BATCH] = queue_push_batch_command_handler;
+	commands[EG_PROTOCOL_CMD_QUEUE_GET_BATCH] = queue_get_batch_command_handler;
+	commands[EG_PROTOCOL_CMD_QUEUE_POP_BATCH] = queue_pop_batch_command_handler;
 
 	commands[EG_PROTOCOL_CMD_ROUTE_CREATE] = route_create_command_handler;
 	commands[EG_PROTOCOL_CMD_ROUTE_EXIST] = route_exist_command_handler;
@@ -267,16 +271,16 @@ void check_memory(void)
 
 void process_queues_messages(void)
 {
-	ListNode *node;
-	ListIterator iterator;
 	Queue_t *queue_t;
+	uint32_t time = server->now_timems;
 
-	list_rewind(server->queues, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
+	while (EG_HEAP_LENGTH(server->queue_timers) &&
+		EG_HEAP_TOP_KEY(server->queue_timers) <= time)
 	{
-		queue_t = EG_LIST_NODE_VALUE(node);
-		process_expired_messages_queue_t(queue_t, server->now_timems);
-		process_unconfirmed_messages_queue_t(queue_t, server->now_timems);
+		queue_t = EG_HEAP_TOP_VALUE(server->queue_timers);
+		process_expired_messages_queue_t(queue_t, time);
+		process_unconfirmed_messages_queue_t(queue_t, time);
+		schedule_queue_t(queue_t);
 	}
 }
 
@@ -293,11 +297,13 @@ void storage_timeout(void)
 				warning("Error background saving data in %s", server->storage);
 			}
 
+			aof_rotate_done(WEXITSTATUS(stat));
+
 			server->child_pid = -1;
 		}
 	}
 
-	if (server->storage_timeout && server->child_pid == -1)
+	if (server->storage_timeout && !storage_save_in_progress())
 	{
 		if ((server->now_time - server->last_save) > server->storage_timeout)
 		{
@@ -323,8 +329,10 @@ int server_updater(EventLoop *loop, long long id, void *data)
 
 	check_memory();
 	client_timeout();
+	release_idle_client_buffers();
 	process_queues_messages();
 	storage_timeout();
+	aof_timeout();
 
 	if (server->shutdown) {
 		stop_event_loop(server->loop);
@@ -333,6 +341,13 @@ int server_updater(EventLoop *loop, long long id, void *data)
 	return 100;
 }
 
+void before_sleep(EventLoop *loop)
+{
+	EG_NOTUSED(loop);
+
+	process_pending_clients();
+}
+
 void init_admin(void)
 {
 	EagleUser *admin;
@@ -353,6 +368,19 @@ void init_storage()
 	if (storage_load(server->storage) != EG_STATUS_OK) {
 		warning("Error loading data from %s", server->storage);
 	}
+
+	if (server->aof)
+	{
+		if (aof_load() != EG_STATUS_OK) {
+			fatal("Error loading append only file %s", server->aof_file);
+		}
+
+		server->now_timems = mstime();
+
+		if (aof_open() != EG_STATUS_OK) {
+			fatal("Error open append only file %s", server->aof_file);
+		}
+	}
 }
 
 void init_server(void)
@@ -373,12 +401,19 @@ void init_server(void)
 
 	server->loop = create_event_loop(server->max_clients + 1);
 
+	if (server->edge_triggered && !get_event_api_edge()) {
+		warning("Edge-triggered events are not supported by %s", get_event_api_name());
+		server->edge_triggered = 0;
+	}
+
 	if (server->port != 0)
 	{
 		server->fd = net_tcp_server(server->error, server->addr, server->port);
 		if (server->fd == EG_NET_ERR) {
 			fatal("Error create server: %s\n%s", server->addr, server->error);
 		}
+
+		net_set_nonblock(NULL, server->fd);
 	}
 
 	if (server->unix_socket != NULL)
@@ -389,9 +424,11 @@ void init_server(void)
 		if (server->sfd == EG_NET_ERR) {
 			fatal("Opening socket: %s\n", server->error);
 		}
+
+		net_set_nonblock(NULL, server->sfd);
 	}
 
-	if (server->fd < 0 && server->sfd < 0) {
+	if (server->fd <= 0 && server->sfd <= 0) {
 		fatal("Error configure server");
 	}
 
@@ -404,16 +441,22 @@ void init_server(void)
 	}
 
 	server->ufd = create_time_event(server->loop, 1, server_updater, NULL, NULL);
+
+	set_before_sleep_handler(server->loop, before_sleep);
 }
 
 void destroy_server()
 {
+	aof_close();
+
 	if (server->child_pid != -1)
 	{
 		kill(server->child_pid, SIGKILL);
 		remove_temp_file(server->child_pid);
 	}
 
+	storage_save_cancel();
+
 	if (server->fd > 0) {
 		close(server->fd);
 	}
@@ -460,17 +503,29 @@ void init_server_config(void)
 	server->unix_socket = NULL;
 	server->unix_perm = 0;
 	server->child_pid = -1;
+	server->fork_time = 0;
 	server->name = xstrdup(EG_DEFAULT_ADMIN_NAME);
 	server->password = xstrdup(EG_DEFAULT_ADMIN_PASSWORD);
 	server->max_clients = EG_DEFAULT_MAX_CLIENTS;
 	server->max_memory = EG_DEFAULT_MAX_MEMORY;
+	server->max_request_size = EG_DEFAULT_MAX_REQUEST_SIZE;
 	server->client_timeout = EG_DEFAULT_CLIENT_TIMEOUT;
+	server->edge_triggered = EG_DEFAULT_EDGE_TRIGGERED;
+	server->read_calls = 0;
+	server->write_calls = 0;
 	server->storage_timeout = EG_DEFAULT_SAVE_TIMEOUT;
+	server->save_mode = EG_DEFAULT_SAVE_MODE;
+	server->storage_codec = EG_DEFAULT_STORAGE_CODEC;
 	server->clients = list_create();
+	server->pending_writes = list_create();
 	server->users = list_create();
 	server->queues = list_create();
 	server->routes = list_create();
 	server->channels = list_create();
+	server->queue_index = dict_create();
+	server->route_index = dict_create();
+	server->channel_index = dict_create();
+	server->queue_timers = heap_create();
 	server->now_time = time(NULL);
 	server->now_timems = mstime();
 	server->start_time = time(NULL);
@@ -480,6 +535,19 @@ void init_server_config(void)
 	server->msg_counter = 0;
 	server->daemonize = EG_DEFAULT_DAEMONIZE;
 	server->storage = xstrdup(EG_DEFAULT_STORAGE_PATH);
+	server->aof = EG_DEFAULT_AOF;
+	server->aof_fd = -1;
+	server->aof_fsync = EG_DEFAULT_AOF_FSYNC;
+	server->aof_unsynced = 0;
+	server->aof_failed = 0;
+	server->aof_size = 0;
+	server->aof_file = xstrdup(EG_DEFAULT_AOF_PATH);
+	server->aof_buf = NULL;
+	server->aof_buflen = 0;
+	server->aof_bufsize = 0;
+	server->aof_seq = 0;
+	server->aof_flushed_seq = 0;
+	server->aof_last_fsync = time(NULL);
 	server->pidfile = NULL;
 	server->logfile = xstrdup(EG_DEFAULT_LOG_PATH);
 	server->config = EG_DEFAULT_CONFIG_PATH;
@@ -489,6 +557,16 @@ void init_server_config(void)
 	EG_LIST_SET_FREE_METHOD(server->queues, free_queue_list_handler);
 	EG_LIST_SET_FREE_METHOD(server->routes, free_route_list_handler);
 	EG_LIST_SET_FREE_METHOD(server->channels, free_channel_list_handler);
+
+	EG_DICT_SET_HASH_METHOD(server->queue_index, dict_string_hash);
+	EG_DICT_SET_HASH_METHOD(server->route_index, dict_string_hash);
+	EG_DICT_SET_HASH_METHOD(server->channel_index, dict_string_hash);
+
+	EG_DICT_SET_MATCH_METHOD(server->queue_index, dict_string_match);
+	EG_DICT_SET_MATCH_METHOD(server->route_index, dict_string_match);
+	EG_DICT_SET_MATCH_METHOD(server->channel_index, dict_string_match);
+
+	EG_HEAP_SET_INDEX_METHOD(server->queue_timers, index_queue_heap_handler);
 }
 
 void destroy_server_config(void)
@@ -497,6 +575,7 @@ void destroy_server_config(void)
 	xfree(server->name);
 	xfree(server->password);
 	xfree(server->storage);
+	xfree(server->aof_file);
 	xfree(server->logfile);
 
 	if (server->unix_socket)
@@ -506,11 +585,18 @@ void destroy_server_config(void)
 		xfree(server->pidfile);
 
 	list_release(server->clients);
+	list_release(server->pending_writes);
 	list_release(server->users);
 	list_release(server->queues);
 	list_release(server->routes);
 	list_release(server->channels);
 
+	dict_release(server->queue_index);
+	dict_release(server->route_index);
+	dict_release(server->channel_index);
+
+	heap_release(server->queue_timers);
+
 	xfree(server);
 }
 
@@ -537,14 +623,21 @@ void usage(void)
 		"--pid-file - path to the PID file\n"
 		"--log-file - path to the log file (default: %s)\n"
 		"--storage-file - path to the storage file (default: %s)\n"
+		"--aof - log changes of durable queues to the append only file [on|off]\n"
+		"--aof-file - path to the append only file (default: %s)\n"
+		"--aof-fsync - sync the append only file [always|everysec|never] (default: everysec)\n"
 		"--max-clients - maximum connections on the server (default: %d)\n"
 		"--max-memory - max memory usage limit (default: %d)\n"
+		"--max-request-size - max size of a client request (default: %d)\n"
 		"--save-timeout - timeout for save data to the storage (default: %d sec)\n"
-		"--client-timeout - timeout to kill not active clients (default: %d sec)\n",
+		"--save-mode - background save by fork or incrementally in the event loop [fork|incremental] (default: fork)\n"
+		"--storage-compression - compression of the storage blocks [lzf|none] (default: lzf)\n"
+		"--client-timeout - timeout to kill not active clients (default: %d sec)\n"
+		"--edge-triggered - drain client sockets on edge-triggered events [on|off]\n",
 			EAGLE_VERSION, EG_DEFAULT_ADDR, EG_DEFAULT_PORT,
 			EG_DEFAULT_ADMIN_NAME, EG_DEFAULT_ADMIN_PASSWORD,
-			EG_DEFAULT_LOG_PATH, EG_DEFAULT_STORAGE_PATH,
-			EG_DEFAULT_MAX_CLIENTS, EG_DEFAULT_MAX_MEMORY,
+			EG_DEFAULT_LOG_PATH, EG_DEFAULT_STORAGE_PATH, EG_DEFAULT_AOF_PATH,
+			EG_DEFAULT_MAX_CLIENTS, EG_DEFAULT_MAX_MEMORY, EG_DEFAULT_MAX_REQUEST_SIZE,
 			EG_DEFAULT_SAVE_TIMEOUT, EG_DEFAULT_CLIENT_TIMEOUT);
 }
 
@@ -34,6 +34,9 @@
 #include "network.h"
 #include "list.h"
 #include "keylist.h"
+#include "dict.h"
+#include "pattern.h"
+#include "heap.h"
 #include "queue.h"
 #include "user.h"
 
@@ -48,14 +51,33 @@
 #define EG_DEFAULT_ADMIN_PASSWORD "eagle"
 #define EG_DEFAULT_MAX_CLIENTS 16384
 #define EG_DEFAULT_MAX_MEMORY 0
+#define EG_DEFAULT_MAX_REQUEST_SIZE 0
+#define EG_DEFAULT_EDGE_TRIGGERED 0
 #define EG_DEFAULT_CLIENT_TIMEOUT 0
 #define EG_DEFAULT_SAVE_TIMEOUT 0
+#define EG_DEFAULT_SAVE_MODE EG_SAVE_MODE_FORK
+#define EG_DEFAULT_STORAGE_CODEC EG_STORAGE_CODEC_LZF
 #define EG_DEFAULT_DAEMONIZE 0
+#define EG_DEFAULT_AOF 0
+#define EG_DEFAULT_AOF_FSYNC EG_AOF_FSYNC_EVERYSEC
 #define EG_DEFAULT_STORAGE_PATH "eaglemq.dat"
+#define EG_DEFAULT_AOF_PATH "eaglemq.aof"
 #define EG_DEFAULT_LOG_PATH "eaglemq.log"
 #define EG_DEFAULT_CONFIG_PATH "eaglemq.conf"
 
 #define EG_BUF_SIZE 32768
+#define EG_MAX_IOV 1024
+#define EG_REPLY_SIZE 16384
+#define EG_REPLY_COPY_SIZE 512
+#define EG_CLIENT_IDLE_TIME 2
+
+#define EG_CLIENT_PENDING_WRITE 1
+
+#define EG_CLIENT_IO_CLOSED -1
+#define EG_CLIENT_IO_DONE 0
+#define EG_CLIENT_IO_AGAIN 1
+
+#define EG_MAX_ACCEPTS_PER_CALL 1000
 
 #define EG_MAX_BUF_SIZE 2147483647
 #define EG_MAX_MSG_COUNT 4294967295
@@ -63,6 +85,16 @@
 
 #define EG_MEMORY_CHECK_TIMEOUT 10
 
+#define EG_AOF_FSYNC_NEVER 0
+#define EG_AOF_FSYNC_EVERYSEC 1
+#define EG_AOF_FSYNC_ALWAYS 2
+
+#define EG_SAVE_MODE_FORK 0
+#define EG_SAVE_MODE_INCREMENTAL 1
+
+#define EG_STORAGE_CODEC_NONE 0
+#define EG_STORAGE_CODEC_LZF 1
+
 #define BIT_SET(a, b) ((a) |= (1UL<<(b)))
 #define BIT_CHECK(a, b) ((a) & (1UL<<(b)))
 
@@ -77,12 +109,15 @@ typedef struct Queue_t {
 	int force_push;
 	int round_robin;
 	Queue *queue;
-	List *expire_messages;
-	List *confirm_messages;
+	Heap *expire_messages;
+	Heap *confirm_messages;
+	Dict *confirm_index;
+	unsigned long timer;
 	List *declared_clients;
 	List *subscribed_clients_msg;
 	List *subscribed_clients_notify;
 	Keylist *routes;
+	void *snapshot;
 } Queue_t;
 
 /* ------- Route ------- */
@@ -104,6 +139,7 @@ typedef struct Channel_t {
 	int round_robin;
 	Keylist *topics;
 	Keylist *patterns;
+	PatternTrie *pattern_trie;
 } Channel_t;
 
 /* ------- Client context ------- */
@@ -112,20 +148,27 @@ typedef struct EagleClient {
 	int fd;
 	uint64_t perm;
 	char *request;
-	size_t length;
 	size_t pos;
 	int noack;
-	int offset;
+	int disconnect;
+	struct Object *body;
 	char *buffer;
+	size_t offset;
 	size_t bodylen;
+	size_t discard;
 	size_t nread;
+	char *reply;
+	size_t replylen;
+	size_t replysent;
 	List *responses;
-	List *declared_queues;
-	List *subscribed_queues;
+	Dict *declared_queues;
+	Dict *subscribed_queues;
 	Keylist *subscribed_topics;
 	Keylist *subscribed_patterns;
 	size_t sentlen;
+	int pending;
 	time_t last_action;
+	uint64_t aof_seq;
 } EagleClient;
 
 /* ------- Server context ------- */
@@ -140,18 +183,30 @@ typedef struct EagleServer {
 	char *unix_socket;
 	mode_t unix_perm;
 	pid_t child_pid;
+	long long fork_time;
 	char *name;
 	char *password;
 	size_t max_clients;
 	long long max_memory;
+	long long max_request_size;
 	int client_timeout;
 	int storage_timeout;
+	int save_mode;
+	int storage_codec;
+	int edge_triggered;
+	unsigned long long read_calls;
+	unsigned long long write_calls;
 	char error[NET_ERR_LEN];
 	List *clients;
+	List *pending_writes;
 	List *users;
 	List *queues;
 	List *routes;
 	List *channels;
+	Dict *queue_index;
+	Dict *route_index;
+	Dict *channel_index;
+	Heap *queue_timers;
 	time_t now_time;
 	time_t now_timems;
 	time_t start_time;
@@ -161,6 +216,19 @@ typedef struct EagleServer {
 	int msg_counter;
 	int daemonize;
 	char *storage;
+	int aof;
+	int aof_fd;
+	int aof_fsync;
+	int aof_unsynced;
+	int aof_failed;
+	off_t aof_size;
+	char *aof_file;
+	char *aof_buf;
+	size_t aof_buflen;
+	size_t aof_bufsize;
+	uint64_t aof_seq;
+	uint64_t aof_flushed_seq;
+	time_t aof_last_fsync;
 	char *pidfile;
 	char *logfile;
 	char *config;
@@ -204,6 +272,9 @@ void queue_subscribe_command_handler(EagleClient *client);
 void queue_unsubscribe_command_handler(EagleClient *client);
 void queue_purge_command_handler(EagleClient *client);
 void queue_delete_command_handler(EagleClient *client);
+void queue_push_batch_command_handler(EagleClient *client);
+void queue_get_batch_command_handler(EagleClient *client);
+void queue_pop_batch_command_handler(EagleClient *client);
 
 void route_create_command_handler(EagleClient *client);
 void route_exist_command_handler(EagleClient *client);
@@ -25,15 +25,20 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include "fmacros.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <poll.h>
 #include <string.h>
 
 #include "xmalloc.h"
+#include "heap.h"
+#include "dict.h"
 #include "event.h"
 
 #ifdef _EVENT_SELECT_
@@ -42,85 +47,54 @@
 	#include "event_epoll.c"
 #endif
 
-static void get_time(long *seconds, long *milliseconds)
+static long long get_monotonic_time(void)
 {
-	struct timeval tv;
+	struct timespec ts;
 
-	gettimeofday(&tv, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	*seconds = tv.tv_sec;
-	*milliseconds = tv.tv_usec / 1000;
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-static void add_milliseconds_to_now(long long milliseconds, long *sec, long *ms)
+static void index_time_event_heap_handler(void *value, unsigned long index)
 {
-	long cur_sec, cur_ms, when_sec, when_ms;
-
-	get_time(&cur_sec, &cur_ms);
+	TimeEvent *time_event = value;
 
-	when_sec = cur_sec + milliseconds / 1000;
-	when_ms = cur_ms + milliseconds % 1000;
-
-	if (when_ms >= 1000) {
-		when_sec++;
-		when_ms -= 1000;
-	}
-
-	*sec = when_sec;
-	*ms = when_ms;
+	time_event->index = index;
 }
 
-static TimeEvent *search_nearest_timer(EventLoop *loop)
+static void free_time_event(EventLoop *loop, TimeEvent *time_event)
 {
-	TimeEvent *time_event = loop->time_event;
-	TimeEvent *nearest = NULL;
-
-	while (time_event)
-	{
-		if (!nearest || time_event->sec < nearest->sec ||
-			(time_event->sec == nearest->sec && time_event->ms < nearest->ms)) {
-			nearest = time_event;
-		}
-
-		time_event = time_event->next;
+	if (time_event->finalizer_handler) {
+		time_event->finalizer_handler(loop, time_event->data);
 	}
 
-	return nearest;
+	xfree(time_event);
 }
 
 static int process_time_events(EventLoop *loop)
 {
 	int processed = 0;
-	TimeEvent *time_event = loop->time_event;
+	TimeEvent *time_event;
 	long long max_id = loop->time_event_id - 1;
-	long sec, ms;
-	long long id;
 	int retval;
 
-	while (time_event)
+	while (EG_HEAP_LENGTH(loop->timers))
 	{
-		if (time_event->id > max_id) {
-			time_event = time_event->next;
-			continue;
-		}
+		time_event = EG_HEAP_TOP_VALUE(loop->timers);
 
-		get_time(&sec, &ms);
-
-		if (sec > time_event->sec || (sec == time_event->sec && ms >= time_event->ms))
-		{
-			id = time_event->id;
-			retval = time_event->time_handler(loop, id, time_event->data);
-			processed++;
+		if (time_event->when > loop->time || time_event->id > max_id) {
+			break;
+		}
 
-			if (retval != -1) {
-				add_milliseconds_to_now(retval, &time_event->sec, &time_event->ms);
-			} else {
-				delete_time_event(loop, id);
-			}
+		retval = time_event->time_handler(loop, time_event->id, time_event->data);
+		processed++;
 
-			time_event = loop->time_event;
+		if (retval != -1) {
+			time_event->when = loop->time + retval;
+			heap_update(loop->timers, time_event->index, time_event->when);
 		} else {
-			time_event = time_event->next;
+			delete_time_event(loop, time_event->id);
 		}
 	}
 
@@ -140,11 +114,22 @@ EventLoop *create_event_loop(int size)
 	loop->maxfd = -1;
 	loop->size = size;
 	loop->time_event_id = 0;
-	loop->time_event = NULL;
+	loop->timers = heap_create();
+	loop->time_events = dict_create();
+	loop->time = get_monotonic_time();
+	loop->poll_calls = 0;
+	loop->ctl_calls = 0;
 	loop->stop = 0;
 	loop->before_sleep_handler = NULL;
 
+	EG_HEAP_SET_INDEX_METHOD(loop->timers, index_time_event_heap_handler);
+
+	EG_DICT_SET_HASH_METHOD(loop->time_events, dict_uint64_hash);
+	EG_DICT_SET_MATCH_METHOD(loop->time_events, dict_uint64_match);
+
 	if (event_api_init(loop) == -1) {
+		heap_release(loop->timers);
+		dict_release(loop->time_events);
 		xfree(loop->events);
 		xfree(loop->fired);
 		xfree(loop);
@@ -160,6 +145,16 @@ EventLoop *create_event_loop(int size)
 
 void delete_event_loop(EventLoop *loop)
 {
+	TimeEvent *time_event;
+
+	while ((time_event = heap_pop(loop->timers)) != NULL) {
+		dict_delete(loop->time_events, &time_event->id);
+		free_time_event(loop, time_event);
+	}
+
+	heap_release(loop->timers);
+	dict_release(loop->time_events);
+
 	event_api_free(loop);
 	xfree(loop->events);
 	xfree(loop->fired);
@@ -181,7 +176,7 @@ int create_file_event(EventLoop *loop, int fd, int mask, file_handler *handler,
 
 	file_event = &loop->events[fd];
 
-	if (event_api_add(loop, fd, mask) == -1) {
+	if ((file_event->mask & mask) != mask && event_api_add(loop, fd, mask) == -1) {
 		return EG_EVENT_ERR;
 	}
 
@@ -215,12 +210,16 @@ void delete_file_event(EventLoop *loop, int fd, int mask)
 
 	file_event = &loop->events[fd];
 
-	if (file_event->mask == EG_EVENT_NONE) {
+	if (!(file_event->mask & mask)) {
 		return;
 	}
 
 	file_event->mask = file_event->mask & (~mask);
 
+	if (!(file_event->mask & (EG_EVENT_READABLE|EG_EVENT_WRITABLE))) {
+		file_event->mask = EG_EVENT_NONE;
+	}
+
 	if (fd == loop->maxfd && file_event->mask == EG_EVENT_NONE) {
 		for (i = loop->maxfd - 1; i >= 0; i--) {
 			if (loop->events[i].mask != EG_EVENT_NONE) {
@@ -253,46 +252,31 @@ long long create_time_event(EventLoop *loop, long long milliseconds, time_handle
 	long long id = loop->time_event_id++;
 
 	time_event->id = id;
-
-	add_milliseconds_to_now(milliseconds, &time_event->sec, &time_event->ms);
-
+	time_event->when = get_monotonic_time() + milliseconds;
 	time_event->time_handler = time_handler;
 	time_event->finalizer_handler = finalizer_handler;
 	time_event->data = data;
-	time_event->next = loop->time_event;
 
-	loop->time_event = time_event;
+	heap_push(loop->timers, time_event->when, time_event);
+	dict_add(loop->time_events, &time_event->id, time_event);
 
 	return id;
 }
 
 int delete_time_event(EventLoop *loop, long long id)
 {
-	TimeEvent *time_event = loop->time_event, *prev = NULL;
-
-	while (time_event)
-	{
-		if (time_event->id == id)
-		{
-			if (prev == NULL) {
-				loop->time_event = time_event->next;
-			} else {
-				prev->next = time_event->next;
-			}
+	TimeEvent *time_event = dict_fetch_value(loop->time_events, &id);
 
-			if (time_event->finalizer_handler) {
-				time_event->finalizer_handler(loop, time_event->data);
-			}
+	if (!time_event) {
+		return EG_EVENT_ERR;
+	}
 
-			xfree(time_event);
-			return EG_EVENT_OK;
-		}
+	dict_delete(loop->time_events, &time_event->id);
+	heap_delete(loop->timers, time_event->index);
 
-		prev = time_event;
-		time_event = time_event->next;
-	}
+	free_time_event(loop, time_event);
 
-	return EG_EVENT_ERR;
+	return EG_EVENT_OK;
 }
 
 int process_events(EventLoop *loop, int flags)
@@ -301,39 +285,31 @@ int process_events(EventLoop *loop, int flags)
 	TimeEvent *shortest = NULL;
 	struct timeval tv, *tvp;
 	int processed = 0, i, mask, fd, rfired, events;
-	long sec, ms;
+	long long timeout;
 
 	if (!(flags & EG_EVENT_TIME) && !(flags & EG_EVENT_FILE)) {
 		return 0;
 	}
 
+	loop->time = get_monotonic_time();
+
 	if (loop->maxfd != -1 || ((flags & EG_EVENT_TIME) && !(flags & EG_DONT_WAIT)))
 	{
-		if (flags & EG_EVENT_TIME && !(flags & EG_DONT_WAIT)) {
-			shortest = search_nearest_timer(loop);
+		if (flags & EG_EVENT_TIME && !(flags & EG_DONT_WAIT) && EG_HEAP_LENGTH(loop->timers)) {
+			shortest = EG_HEAP_TOP_VALUE(loop->timers);
 		}
 
 		if (shortest)
 		{
-			get_time(&sec, &ms);
-
-			tvp = &tv;
-			tvp->tv_sec = shortest->sec - sec;
-
-			if (shortest->ms < ms) {
-				tvp->tv_usec = ((shortest->ms + 1000) - ms) * 1000;
-				tvp->tv_sec--;
-			} else {
-				tvp->tv_usec = (shortest->ms - ms) * 1000;
-			}
+			timeout = shortest->when - loop->time;
 
-			if (tvp->tv_sec < 0) {
-				tvp->tv_sec = 0;
+			if (timeout < 0) {
+				timeout = 0;
 			}
 
-			if (tvp->tv_usec < 0) {
-				tvp->tv_usec = 0;
-			}
+			tvp = &tv;
+			tvp->tv_sec = timeout / 1000;
+			tvp->tv_usec = (timeout % 1000) * 1000;
 		} else {
 			if (flags & EG_DONT_WAIT) {
 				tv.tv_sec = tv.tv_usec = 0;
@@ -343,6 +319,7 @@ int process_events(EventLoop *loop, int flags)
 			}
 		}
 
+		loop->poll_calls++;
 		events = event_api_poll(loop, tvp);
 		for (i = 0; i < events; i++)
 		{
@@ -365,6 +342,8 @@ int process_events(EventLoop *loop, int flags)
 		}
 	}
 
+	loop->time = get_monotonic_time();
+
 	if (flags & EG_EVENT_TIME) {
 		processed += process_time_events(loop);
 	}
@@ -428,3 +407,8 @@ char *get_event_api_name(void)
 {
 	return event_api_name();
 }
+
+int get_event_api_edge(void)
+{
+	return event_api_edge();
+}
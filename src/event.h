@@ -28,12 +28,16 @@
 #ifndef __EVENT_H__
 #define __EVENT_H__
 
+#include "heap.h"
+#include "dict.h"
+
 #define EG_EVENT_OK 0
 #define EG_EVENT_ERR -1
 
 #define EG_EVENT_NONE 0
 #define EG_EVENT_READABLE 1
 #define EG_EVENT_WRITABLE 2
+#define EG_EVENT_EDGE 4
 
 #define EG_EVENT_FILE 1
 #define EG_EVENT_TIME 2
@@ -56,12 +60,11 @@ typedef struct FileEvent {
 
 typedef struct TimeEvent {
 	long long id;
-	long sec;
-	long ms;
+	long long when;
+	unsigned long index;
 	time_handler *time_handler;
 	finalizer_handler *finalizer_handler;
 	void *data;
-	struct TimeEvent *next;
 } TimeEvent;
 
 typedef struct FiredEvent {
@@ -75,7 +78,11 @@ typedef struct EventLoop {
 	long long time_event_id;
 	FileEvent *events;
 	FiredEvent *fired;
-	TimeEvent *time_event;
+	Heap *timers;
+	Dict *time_events;
+	long long time;
+	unsigned long long poll_calls;
+	unsigned long long ctl_calls;
 	int stop;
 	void *api_data;
 	before_sleep_handler *before_sleep_handler;
@@ -94,5 +101,6 @@ int process_events(EventLoop *loop, int flags);
 void start_main_loop(EventLoop *loop);
 void set_before_sleep_handler(EventLoop *loop, before_sleep_handler *before_sleep_handler);
 char *get_event_api_name(void);
+int get_event_api_edge(void);
 
 #endif
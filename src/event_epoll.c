@@ -76,9 +76,15 @@ static int event_api_add(EventLoop *loop, int fd, int mask)
 		epoll_ev.events |= EPOLLOUT;
 	}
 
+	if (mask & EG_EVENT_EDGE) {
+		epoll_ev.events |= EPOLLET;
+	}
+
 	epoll_ev.data.u64 = 0;
 	epoll_ev.data.fd = fd;
 
+	loop->ctl_calls++;
+
 	if (epoll_ctl(data->epfd, op, fd, &epoll_ev) == -1) {
 		return -1;
 	}
@@ -102,9 +108,15 @@ static void event_api_delete(EventLoop *loop, int fd, int mask)
 		epoll_ev.events |= EPOLLOUT;
 	}
 
+	if (nmask & EG_EVENT_EDGE) {
+		epoll_ev.events |= EPOLLET;
+	}
+
 	epoll_ev.data.u64 = 0;
 	epoll_ev.data.fd = fd;
 
+	loop->ctl_calls++;
+
 	if (nmask != EG_EVENT_NONE) {
 		epoll_ctl(data->epfd, EPOLL_CTL_MOD, fd, &epoll_ev);
 	} else {
@@ -157,3 +169,8 @@ static char *event_api_name(void)
 {
 	return "epoll";
 }
+
+static int event_api_edge(void)
+{
+	return 1;
+}
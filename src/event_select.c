@@ -133,3 +133,8 @@ static char *event_api_name(void)
 {
 	return "select";
 }
+
+static int event_api_edge(void)
+{
+	return 0;
+}
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/resource.h>
 #include <errno.h>
 #include <time.h>
@@ -43,18 +44,24 @@
 #include "event.h"
 #include "network.h"
 #include "list.h"
+#include "dict.h"
 #include "user.h"
 #include "queue_t.h"
 #include "route_t.h"
 #include "channel_t.h"
 #include "storage.h"
+#include "aof.h"
 #include "xmalloc.h"
 #include "utils.h"
 
 static int set_write_event(EagleClient *client);
+static void send_response(EventLoop *loop, int fd, void *data, int mask);
+static void add_reply(EagleClient *client, const void *data, size_t size);
 static void add_response(EagleClient *client, void *data, int size);
 static void add_object_response(EagleClient *client, Object *object);
 static void add_status_response(EagleClient *client, int cmd, int status);
+static uint32_t add_message_batch_response(EagleClient *client, int cmd, Queue_t *queue_t, uint32_t count);
+static Object *create_request_object(EagleClient *client, size_t offset);
 static void accept_common_handler(int fd);
 
 static inline void set_response_header(ProtocolResponseHeader *header, uint8_t cmd, uint8_t status, uint32_t bodylen)
@@ -75,25 +82,27 @@ static inline void set_event_header(ProtocolEventHeader *header, uint8_t cmd, ui
 
 static void eject_queue_client(EagleClient *client)
 {
-	ListIterator iterator;
-	ListNode *node;
+	DictIterator *iterator;
+	DictEntry *entry;
 	Queue_t *queue_t;
 
-	list_rewind(client->subscribed_queues, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
+	iterator = dict_get_iterator(client->subscribed_queues);
+	while ((entry = dict_next_entry(iterator)) != NULL)
 	{
-		queue_t = EG_LIST_NODE_VALUE(node);
+		queue_t = EG_DICT_ENTRY_VALUE(entry);
 		unsubscribe_client_queue_t(queue_t, client);
 	}
+	dict_release_iterator(iterator);
 
-	list_rewind(client->declared_queues, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
+	iterator = dict_get_iterator(client->declared_queues);
+	while ((entry = dict_next_entry(iterator)) != NULL)
 	{
-		queue_t = EG_LIST_NODE_VALUE(node);
+		queue_t = EG_DICT_ENTRY_VALUE(entry);
 
 		undeclare_client_queue_t(queue_t, client);
 		process_queue_t(queue_t);
 	}
+	dict_release_iterator(iterator);
 }
 
 static void eject_channel_client(EagleClient *client)
@@ -161,7 +170,7 @@ static void delete_queues(void)
 	list_rewind(server->queues, &iterator);
 	while ((node = list_next_node(&iterator)) != NULL)
 	{
-		list_delete_node(server->queues, node);
+		unregister_queue_t(EG_LIST_NODE_VALUE(node));
 	}
 }
 
@@ -173,7 +182,7 @@ static void delete_routes(void)
 	list_rewind(server->routes, &iterator);
 	while ((node = list_next_node(&iterator)) != NULL)
 	{
-		list_delete_node(server->routes, node);
+		unregister_route_t(EG_LIST_NODE_VALUE(node));
 	}
 }
 
@@ -185,7 +194,7 @@ static void delete_channels(void)
 	list_rewind(server->channels, &iterator);
 	while ((node = list_next_node(&iterator)) != NULL)
 	{
-		list_delete_node(server->channels, node);
+		unregister_channel_t(EG_LIST_NODE_VALUE(node));
 	}
 }
 
@@ -265,8 +274,13 @@ void stat_command_handler(EagleClient *client)
 	stat->body.queues = EG_LIST_LENGTH(server->queues);
 	stat->body.routes = EG_LIST_LENGTH(server->routes);
 	stat->body.channels = EG_LIST_LENGTH(server->channels);
-	stat->body.resv3 = 0;
+	stat->body.client_memory = get_client_memory();
 	stat->body.resv4 = 0;
+	stat->body.read_calls = server->read_calls;
+	stat->body.write_calls = server->write_calls;
+	stat->body.poll_calls = server->loop->poll_calls;
+	stat->body.ctl_calls = server->loop->ctl_calls;
+	stat->body.fork_time = server->fork_time;
 
 	add_response(client, stat, sizeof(*stat));
 }
@@ -295,6 +309,8 @@ void save_command_handler(EagleClient *client)
 	{
 		if (storage_save(server->storage) != EG_STATUS_OK) {
 			add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
+		} else {
+			aof_reset();
 		}
 	}
 
@@ -343,7 +359,7 @@ void disconnect_command_handler(EagleClient *client)
 		return;
 	}
 
-	free_client(client);
+	client->disconnect = 1;
 }
 
 void user_create_command_handler(EagleClient *client)
@@ -550,7 +566,7 @@ void queue_create_command_handler(EagleClient *client)
 		return;
 	}
 
-	if (find_queue_t(server->queues, req->body.name)) {
+	if (find_queue_t(req->body.name)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -563,7 +579,7 @@ void queue_create_command_handler(EagleClient *client)
 	queue_t = create_queue_t(req->body.name, req->body.max_msg,
 		((req->body.max_msg_size == 0) ? EG_MAX_MSG_SIZE : req->body.max_msg_size), req->body.flags);
 
-	list_add_value_tail(server->queues, queue_t);
+	register_queue_t(queue_t);
 
 	add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS);
 }
@@ -589,13 +605,13 @@ void queue_declare_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(server->queues, req->body.name);
+	queue_t = find_queue_t(req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	if (find_queue_t(client->declared_queues, req->body.name)) {
+	if (find_declared_queue_t(client, req->body.name)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS);
 		return;
 	}
@@ -630,7 +646,7 @@ void queue_exist_command_handler(EagleClient *client)
 
 	set_response_header(&res->header, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS, sizeof(res->body));
 
-	if (find_queue_t(server->queues, req->body.name)) {
+	if (find_queue_t(req->body.name)) {
 		res->body.status = 1;
 	} else {
 		res->body.status = 0;
@@ -718,13 +734,13 @@ void queue_rename_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(server->queues, req->body.from);
+	queue_t = find_queue_t(req->body.from);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	if (find_queue_t(server->queues, req->body.to)) {
+	if (find_queue_t(req->body.to)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_VALUE);
 		return;
 	}
@@ -756,7 +772,7 @@ void queue_size_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(server->queues, req->body.name);
+	queue_t = find_queue_t(req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -776,9 +792,9 @@ void queue_push_command_handler(EagleClient *client)
 	ProtocolRequestHeader *req = (ProtocolRequestHeader*)client->request;
 	Queue_t *queue_t;
 	Object *msg;
-	char *queue_name, *msg_data;
+	char *queue_name;
 	uint32_t expire;
-	size_t msg_size;
+	int status;
 
 	if (client->pos < (sizeof(*req) + 69)) {
 		add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
@@ -803,23 +819,30 @@ void queue_push_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(client->declared_queues, queue_name);
+	queue_t = find_declared_queue_t(client, queue_name);
 	if (!queue_t) {
 		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
 		return;
 	}
 
-	msg_data = client->request + sizeof(*req) + 64 + sizeof(uint32_t);
-	msg_size = client->pos - (sizeof(*req) + 64 + sizeof(uint32_t));
+	if (!aof_writable(queue_t)) {
+		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR);
+		return;
+	}
+
 	expire = *((uint32_t*)(client->request + sizeof(*req) + 64));
 
 	if (expire) {
 		expire += server->now_timems;
 	}
 
-	msg = create_dup_object(msg_data, msg_size);
+	msg = create_request_object(client, sizeof(*req) + 64 + sizeof(uint32_t));
+
+	status = push_message_queue_t(queue_t, msg, expire);
 
-	if (push_message_queue_t(queue_t, msg, expire) == EG_STATUS_ERR) {
+	decrement_references_count(msg);
+
+	if (status == EG_STATUS_ERR) {
 		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -827,13 +850,207 @@ void queue_push_command_handler(EagleClient *client)
 	add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_SUCCESS);
 }
 
+static int parse_push_batch(EagleClient *client, size_t offset)
+{
+	uint32_t length;
+	int count = 0;
+
+	while (offset < client->pos)
+	{
+		if (client->pos - offset < sizeof(uint32_t)) {
+			return -1;
+		}
+
+		length = *((uint32_t*)(client->request + offset));
+		offset += sizeof(uint32_t);
+
+		if (length == 0 || length > client->pos - offset) {
+			return -1;
+		}
+
+		offset += length;
+		count++;
+	}
+
+	return count;
+}
+
+void queue_push_batch_command_handler(EagleClient *client)
+{
+	ProtocolRequestHeader *req = (ProtocolRequestHeader*)client->request;
+	ProtocolResponseQueuePushBatch res;
+	Queue_t *queue_t;
+	Object *msg;
+	char *queue_name;
+	size_t offset = sizeof(*req) + 64 + sizeof(uint32_t);
+	uint32_t expire, length;
+	int count, pushed, status;
+
+	if (client->pos < offset + sizeof(uint32_t) + 1) {
+		add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
+		return;
+	}
+
+	if (!BIT_CHECK(client->perm, EG_USER_ADMIN_PERM) && !BIT_CHECK(client->perm, EG_USER_QUEUE_PERM)
+		&& !BIT_CHECK(client->perm, EG_USER_QUEUE_PUSH_PERM)) {
+		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR_ACCESS);
+		return;
+	}
+
+	queue_name = client->request + sizeof(*req);
+
+	if (!check_input_buffer2(queue_name, 64)) {
+		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR_VALUE);
+		return;
+	}
+
+	count = parse_push_batch(client, offset);
+	if (count == -1) {
+		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR_PACKET);
+		return;
+	}
+
+	if (server->nomemory) {
+		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR_MEMORY);
+		return;
+	}
+
+	queue_t = find_declared_queue_t(client, queue_name);
+	if (!queue_t) {
+		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
+		return;
+	}
+
+	if (!aof_writable(queue_t)) {
+		add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR);
+		return;
+	}
+
+	expire = *((uint32_t*)(client->request + sizeof(*req) + 64));
+
+	if (expire) {
+		expire += server->now_timems;
+	}
+
+	for (pushed = 0; pushed < count; pushed++)
+	{
+		length = *((uint32_t*)(client->request + offset));
+		offset += sizeof(uint32_t);
+
+		msg = create_dup_object(client->request + offset, length);
+		offset += length;
+
+		status = push_message_queue_t(queue_t, msg, expire);
+
+		decrement_references_count(msg);
+
+		if (status == EG_STATUS_ERR) {
+			break;
+		}
+	}
+
+	if (pushed < count)
+	{
+		if (!client->noack)
+		{
+			set_response_header(&res.header, req->cmd, EG_PROTOCOL_STATUS_ERROR, sizeof(res.body));
+			res.body.pushed = pushed;
+
+			add_reply(client, &res, sizeof(res));
+		}
+		return;
+	}
+
+	add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_SUCCESS);
+}
+
+void queue_get_batch_command_handler(EagleClient *client)
+{
+	ProtocolRequestQueueGetBatch *req = (ProtocolRequestQueueGetBatch*)client->request;
+	Queue_t *queue_t;
+
+	if (client->pos < sizeof(*req)) {
+		add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
+		return;
+	}
+
+	if (!BIT_CHECK(client->perm, EG_USER_ADMIN_PERM) && !BIT_CHECK(client->perm, EG_USER_QUEUE_PERM)
+		&& !BIT_CHECK(client->perm, EG_USER_QUEUE_GET_PERM)) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_ACCESS);
+		return;
+	}
+
+	if (!check_input_buffer2(req->body.name, 64) || !req->body.count) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_VALUE);
+		return;
+	}
+
+	queue_t = find_declared_queue_t(client, req->body.name);
+	if (!queue_t) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
+		return;
+	}
+
+	if (!get_size_queue_t(queue_t)) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NO_DATA);
+		return;
+	}
+
+	add_message_batch_response(client, req->header.cmd, queue_t, req->body.count);
+}
+
+void queue_pop_batch_command_handler(EagleClient *client)
+{
+	ProtocolRequestQueuePopBatch *req = (ProtocolRequestQueuePopBatch*)client->request;
+	Queue_t *queue_t;
+	uint32_t count;
+
+	if (client->pos < sizeof(*req)) {
+		add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
+		return;
+	}
+
+	if (!BIT_CHECK(client->perm, EG_USER_ADMIN_PERM) && !BIT_CHECK(client->perm, EG_USER_QUEUE_PERM)
+		&& !BIT_CHECK(client->perm, EG_USER_QUEUE_POP_PERM)) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_ACCESS);
+		return;
+	}
+
+	if (!check_input_buffer2(req->body.name, 64) || !req->body.count) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_VALUE);
+		return;
+	}
+
+	queue_t = find_declared_queue_t(client, req->body.name);
+	if (!queue_t) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
+		return;
+	}
+
+	if (!aof_writable(queue_t)) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
+		return;
+	}
+
+	if (!get_size_queue_t(queue_t)) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NO_DATA);
+		return;
+	}
+
+	count = add_message_batch_response(client, req->header.cmd, queue_t, req->body.count);
+
+	while (count--) {
+		pop_message_queue_t(queue_t, req->body.timeout);
+	}
+}
+
 void queue_get_command_handler(EagleClient *client)
 {
 	ProtocolRequestQueueGet *req = (ProtocolRequestQueueGet*)client->request;
 	ProtocolResponseHeader res;
 	Queue_t *queue_t;
 	Message *msg;
-	char *buffer;
+	char buffer[sizeof(res) + sizeof(uint64_t)];
 
 	if (client->pos < sizeof(*req)) {
 		add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
@@ -851,7 +1068,7 @@ void queue_get_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(client->declared_queues, req->body.name);
+	queue_t = find_declared_queue_t(client, req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
 		return;
@@ -865,12 +1082,10 @@ void queue_get_command_handler(EagleClient *client)
 
 	set_response_header(&res, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS, EG_MESSAGE_SIZE(msg) + sizeof(uint64_t));
 
-	buffer = (char*)xmalloc(sizeof(res) + sizeof(uint64_t));
-
 	memcpy(buffer, &res, sizeof(res));
 	memcpy(buffer + sizeof(res), &msg->tag, sizeof(uint64_t));
 
-	add_response(client, buffer, sizeof(res) + sizeof(uint64_t));
+	add_reply(client, buffer, sizeof(res) + sizeof(uint64_t));
 	add_object_response(client, EG_MESSAGE_OBJECT(msg));
 }
 
@@ -880,7 +1095,7 @@ void queue_pop_command_handler(EagleClient *client)
 	ProtocolResponseHeader res;
 	Queue_t *queue_t;
 	Message *msg;
-	char *buffer;
+	char buffer[sizeof(res) + sizeof(uint64_t)];
 
 	if (client->pos < sizeof(*req)) {
 		add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
@@ -898,12 +1113,17 @@ void queue_pop_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(client->declared_queues, req->body.name);
+	queue_t = find_declared_queue_t(client, req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
 		return;
 	}
 
+	if (!aof_writable(queue_t)) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
+		return;
+	}
+
 	msg = get_message_queue_t(queue_t);
 	if (!msg) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NO_DATA);
@@ -912,12 +1132,10 @@ void queue_pop_command_handler(EagleClient *client)
 
 	set_response_header(&res, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS, EG_MESSAGE_SIZE(msg) + sizeof(uint64_t));
 
-	buffer = (char*)xmalloc(sizeof(res) + sizeof(uint64_t));
-
 	memcpy(buffer, &res, sizeof(res));
 	memcpy(buffer + sizeof(res), &msg->tag, sizeof(uint64_t));
 
-	add_response(client, buffer, sizeof(res) + sizeof(uint64_t));
+	add_reply(client, buffer, sizeof(res) + sizeof(uint64_t));
 	add_object_response(client, EG_MESSAGE_OBJECT(msg));
 
 	pop_message_queue_t(queue_t, req->body.timeout);
@@ -944,12 +1162,17 @@ void queue_confirm_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(client->declared_queues, req->body.name);
+	queue_t = find_declared_queue_t(client, req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
 		return;
 	}
 
+	if (!aof_writable(queue_t)) {
+		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
+		return;
+	}
+
 	if (confirm_message_queue_t(queue_t, req->body.tag) != EG_STATUS_OK) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NO_DATA);
 		return;
@@ -979,13 +1202,13 @@ void queue_subscribe_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(client->declared_queues, req->body.name);
+	queue_t = find_declared_queue_t(client, req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
 		return;
 	}
 
-	if (find_queue_t(client->subscribed_queues, req->body.name)) {
+	if (find_subscribed_queue_t(client, req->body.name)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -1016,13 +1239,13 @@ void queue_unsubscribe_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(client->declared_queues, req->body.name);
+	queue_t = find_declared_queue_t(client, req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
 		return;
 	}
 
-	if (!find_queue_t(client->subscribed_queues, req->body.name)) {
+	if (!find_subscribed_queue_t(client, req->body.name)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -1053,7 +1276,7 @@ void queue_purge_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(client->declared_queues, req->body.name);
+	queue_t = find_declared_queue_t(client, req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_DECLARED);
 		return;
@@ -1085,13 +1308,13 @@ void queue_delete_command_handler(EagleClient *client)
 		return;
 	}
 
-	queue_t = find_queue_t(server->queues, req->body.name);
+	queue_t = find_queue_t(req->body.name);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	if (list_delete_value(server->queues, queue_t) == EG_STATUS_ERR) {
+	if (unregister_queue_t(queue_t) == EG_STATUS_ERR) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -1120,14 +1343,14 @@ void route_create_command_handler(EagleClient *client)
 		return;
 	}
 
-	if (find_route_t(server->routes, req->body.name)) {
+	if (find_route_t(req->body.name)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
 
 	route = create_route_t(req->body.name, req->body.flags);
 
-	list_add_value_tail(server->routes, route);
+	register_route_t(route);
 
 	add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS);
 }
@@ -1157,7 +1380,7 @@ void route_exist_command_handler(EagleClient *client)
 
 	set_response_header(&res->header, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS, sizeof(res->body));
 
-	if (find_route_t(server->routes, req->body.name)) {
+	if (find_route_t(req->body.name)) {
 		res->body.status = 1;
 	} else {
 		res->body.status = 0;
@@ -1245,7 +1468,7 @@ void route_keys_command_handler(EagleClient *client)
 		return;
 	}
 
-	route = find_route_t(server->routes, req->body.name);
+	route = find_route_t(req->body.name);
 	if (!route) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -1301,13 +1524,13 @@ void route_rename_command_handler(EagleClient *client)
 		return;
 	}
 
-	route = find_route_t(server->routes, req->body.from);
+	route = find_route_t(req->body.from);
 	if (!route) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	if (find_route_t(server->routes, req->body.to)) {
+	if (find_route_t(req->body.to)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_VALUE);
 		return;
 	}
@@ -1340,13 +1563,13 @@ void route_bind_command_handler(EagleClient *client)
 		return;
 	}
 
-	route = find_route_t(server->routes, req->body.name);
+	route = find_route_t(req->body.name);
 	if (!route) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	queue_t = find_queue_t(server->queues, req->body.queue);
+	queue_t = find_queue_t(req->body.queue);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -1380,13 +1603,13 @@ void route_unbind_command_handler(EagleClient *client)
 		return;
 	}
 
-	route = find_route_t(server->routes, req->body.name);
+	route = find_route_t(req->body.name);
 	if (!route) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	queue_t = find_queue_t(server->queues, req->body.queue);
+	queue_t = find_queue_t(req->body.queue);
 	if (!queue_t) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -1405,9 +1628,8 @@ void route_push_command_handler(EagleClient *client)
 	ProtocolRequestRoutePush *req = (ProtocolRequestRoutePush*)client->request;
 	Route_t *route;
 	Object *msg;
-	char *msg_data;
 	uint32_t expire;
-	size_t msg_size;
+	int status;
 
 	if (client->pos < (sizeof(*req) + 5)) {
 		add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
@@ -1430,24 +1652,25 @@ void route_push_command_handler(EagleClient *client)
 		return;
 	}
 
-	route = find_route_t(server->routes, req->body.name);
+	route = find_route_t(req->body.name);
 	if (!route) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	msg_data = client->request + sizeof(*req) + sizeof(uint32_t);
-	msg_size = client->pos - (sizeof(*req) + sizeof(uint32_t));
 	expire = *((uint32_t*)(client->request + sizeof(*req)));
 
 	if (expire) {
 		expire += server->now_timems;
 	}
 
-	msg = create_dup_object(msg_data, msg_size);
-	EG_OBJECT_RESET_REFCOUNT(msg);
+	msg = create_request_object(client, sizeof(*req) + sizeof(uint32_t));
 
-	if (push_message_route_t(route, req->body.key, msg, expire) != EG_STATUS_OK) {
+	status = push_message_route_t(route, req->body.key, msg, expire);
+
+	decrement_references_count(msg);
+
+	if (status != EG_STATUS_OK) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -1476,13 +1699,13 @@ void route_delete_command_handler(EagleClient *client)
 		return;
 	}
 
-	route = find_route_t(server->routes, req->body.name);
+	route = find_route_t(req->body.name);
 	if (!route) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	if (list_delete_value(server->routes, route) == EG_STATUS_ERR) {
+	if (unregister_route_t(route) == EG_STATUS_ERR) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -1511,14 +1734,14 @@ void channel_create_command_handler(EagleClient *client)
 		return;
 	}
 
-	if (find_channel_t(server->channels, req->body.name)) {
+	if (find_channel_t(req->body.name)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
 
 	channel = create_channel_t(req->body.name, req->body.flags);
 
-	list_add_value_tail(server->channels, channel);
+	register_channel_t(channel);
 
 	add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS);
 }
@@ -1548,7 +1771,7 @@ void channel_exist_command_handler(EagleClient *client)
 
 	set_response_header(&res->header, req->header.cmd, EG_PROTOCOL_STATUS_SUCCESS, sizeof(res->body));
 
-	if (find_channel_t(server->channels, req->body.name)) {
+	if (find_channel_t(req->body.name)) {
 		res->body.status = 1;
 	} else {
 		res->body.status = 0;
@@ -1630,13 +1853,13 @@ void channel_rename_command_handler(EagleClient *client)
 		return;
 	}
 
-	channel = find_channel_t(server->channels, req->body.from);
+	channel = find_channel_t(req->body.from);
 	if (!channel) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	if (find_channel_t(server->channels, req->body.to)) {
+	if (find_channel_t(req->body.to)) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_VALUE);
 		return;
 	}
@@ -1668,13 +1891,13 @@ void channel_publish_command_handler(EagleClient *client)
 		return;
 	}
 
-	channel = find_channel_t(server->channels, req->body.name);
+	channel = find_channel_t(req->body.name);
 	if (!channel) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	msg = create_dup_object(client->request + sizeof(*req), client->pos - sizeof(*req));
+	msg = create_request_object(client, sizeof(*req));
 
 	publish_message_channel_t(channel, req->body.topic, msg);
 
@@ -1704,7 +1927,7 @@ void channel_subscribe_command_handler(EagleClient *client)
 		return;
 	}
 
-	channel = find_channel_t(server->channels, req->body.name);
+	channel = find_channel_t(req->body.name);
 	if (!channel) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -1736,7 +1959,7 @@ void channel_psubscribe_command_handler(EagleClient *client)
 		return;
 	}
 
-	channel = find_channel_t(server->channels, req->body.name);
+	channel = find_channel_t(req->body.name);
 	if (!channel) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -1768,7 +1991,7 @@ void channel_unsubscribe_command_handler(EagleClient *client)
 		return;
 	}
 
-	channel = find_channel_t(server->channels, req->body.name);
+	channel = find_channel_t(req->body.name);
 	if (!channel) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -1802,7 +2025,7 @@ void channel_punsubscribe_command_handler(EagleClient *client)
 		return;
 	}
 
-	channel = find_channel_t(server->channels, req->body.name);
+	channel = find_channel_t(req->body.name);
 	if (!channel) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
@@ -1836,13 +2059,13 @@ void channel_delete_command_handler(EagleClient *client)
 		return;
 	}
 
-	channel = find_channel_t(server->channels, req->body.name);
+	channel = find_channel_t(req->body.name);
 	if (!channel) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR_NOT_FOUND);
 		return;
 	}
 
-	if (list_delete_value(server->channels, channel) == EG_STATUS_ERR) {
+	if (unregister_channel_t(channel) == EG_STATUS_ERR) {
 		add_status_response(client, req->header.cmd, EG_PROTOCOL_STATUS_ERROR);
 		return;
 	}
@@ -1852,45 +2075,47 @@ void channel_delete_command_handler(EagleClient *client)
 
 void queue_client_event_notify(EagleClient *client, Queue_t *queue_t)
 {
-	ProtocolEventQueueNotify *event = (ProtocolEventQueueNotify*)xcalloc(sizeof(*event));
+	ProtocolEventQueueNotify event;
+
+	memset(&event, 0, sizeof(event));
 
-	set_event_header(&event->header, EG_PROTOCOL_CMD_QUEUE_SUBSCRIBE, EG_PROTOCOL_EVENT_NOTIFY, sizeof(event->body));
+	set_event_header(&event.header, EG_PROTOCOL_CMD_QUEUE_SUBSCRIBE, EG_PROTOCOL_EVENT_NOTIFY, sizeof(event.body));
 
-	memcpy(event->body.name, queue_t->name, strlenz(queue_t->name));
+	memcpy(event.body.name, queue_t->name, strlenz(queue_t->name));
 
-	add_response(client, event, sizeof(*event));
+	add_reply(client, &event, sizeof(event));
 }
 
 void queue_client_event_message(EagleClient *client, Queue_t *queue_t, Message *msg)
 {
 	ProtocolEventHeader header;
-	char *buffer;
+	char buffer[sizeof(header) + 64];
 
 	set_event_header(&header, EG_PROTOCOL_CMD_QUEUE_SUBSCRIBE, EG_PROTOCOL_EVENT_MESSAGE, 64 + EG_MESSAGE_SIZE(msg));
 
-	buffer = (char*)xcalloc(sizeof(header) + 64);
+	memset(buffer, 0, sizeof(buffer));
 
 	memcpy(buffer, &header, sizeof(header));
 	memcpy(buffer + sizeof(header), queue_t->name, strlenz(queue_t->name));
 
-	add_response(client, buffer, sizeof(header) + 64);
+	add_reply(client, buffer, sizeof(buffer));
 	add_object_response(client, EG_MESSAGE_OBJECT(msg));
 }
 
 void channel_client_event_message(EagleClient *client, Channel_t *channel, const char *topic, Object *msg)
 {
 	ProtocolEventHeader header;
-	char *buffer;
+	char buffer[sizeof(header) + 96];
 
 	set_event_header(&header, EG_PROTOCOL_CMD_CHANNEL_SUBSCRIBE, EG_PROTOCOL_EVENT_MESSAGE, 96 + EG_OBJECT_SIZE(msg));
 
-	buffer = (char*)xcalloc(sizeof(header) + 96);
+	memset(buffer, 0, sizeof(buffer));
 
 	memcpy(buffer, &header, sizeof(header));
 	memcpy(buffer + sizeof(header), channel->name, strlenz(channel->name));
 	memcpy(buffer + sizeof(header) + 64, topic, strlenz(topic));
 
-	add_response(client, buffer, sizeof(header) + 96);
+	add_reply(client, buffer, sizeof(buffer));
 	add_object_response(client, msg);
 }
 
@@ -1898,57 +2123,166 @@ void channel_client_event_pattern_message(EagleClient *client, Channel_t *channe
 	const char *topic, const char *pattern, Object *msg)
 {
 	ProtocolEventHeader header;
-	char *buffer;
+	char buffer[sizeof(header) + 128];
 
 	set_event_header(&header, EG_PROTOCOL_CMD_CHANNEL_PSUBSCRIBE, EG_PROTOCOL_EVENT_MESSAGE, 128 + EG_OBJECT_SIZE(msg));
 
-	buffer = (char*)xcalloc(sizeof(header) + 128);
+	memset(buffer, 0, sizeof(buffer));
 
 	memcpy(buffer, &header, sizeof(header));
 	memcpy(buffer + sizeof(header), channel->name, strlenz(channel->name));
 	memcpy(buffer + sizeof(header) + 64, topic, strlenz(topic));
 	memcpy(buffer + sizeof(header) + 96, pattern, strlenz(pattern));
 
-	add_response(client, buffer, sizeof(header) + 128);
+	add_reply(client, buffer, sizeof(buffer));
 	add_object_response(client, msg);
 }
 
-static void add_response(EagleClient *client, void *data, int size)
+static int add_reply_buffer(EagleClient *client, const void *data, size_t size)
 {
-	Object *object = create_object(data, size);
+	if (EG_LIST_LENGTH(client->responses) || client->replylen + size > EG_REPLY_SIZE) {
+		return EG_STATUS_ERR;
+	}
 
+	if (!client->reply) {
+		client->reply = (char*)xarena_alloc(EG_REPLY_SIZE);
+	}
+
+	memcpy(client->reply + client->replylen, data, size);
+	client->replylen += size;
+
+	return EG_STATUS_OK;
+}
+
+static void add_reply(EagleClient *client, const void *data, size_t size)
+{
 	if (set_write_event(client) != EG_STATUS_OK) {
-		release_object(object);
 		return;
 	}
 
-	list_add_value_tail(client->responses, object);
+	if (add_reply_buffer(client, data, size) != EG_STATUS_OK) {
+		list_add_value_tail(client->responses, create_dup_object((void*)data, size));
+	}
 }
 
-static void add_object_response(EagleClient *client, Object *object)
+static void add_response(EagleClient *client, void *data, int size)
 {
-	increment_references_count(object);
+	if (set_write_event(client) != EG_STATUS_OK) {
+		xfree(data);
+		return;
+	}
 
+	if (add_reply_buffer(client, data, size) == EG_STATUS_OK) {
+		xfree(data);
+		return;
+	}
+
+	list_add_value_tail(client->responses, create_object(data, size));
+}
+
+static void add_object_response(EagleClient *client, Object *object)
+{
 	if (set_write_event(client) != EG_STATUS_OK) {
-		decrement_references_count(object);
 		return;
 	}
 
+	if (EG_OBJECT_SIZE(object) <= EG_REPLY_COPY_SIZE &&
+		add_reply_buffer(client, EG_OBJECT_DATA(object), EG_OBJECT_SIZE(object)) == EG_STATUS_OK) {
+		return;
+	}
+
+	increment_references_count(object);
 	list_add_value_tail(client->responses, object);
 }
 
 static void add_status_response(EagleClient *client, int cmd, int status)
 {
-	ProtocolResponseHeader *res;
+	ProtocolResponseHeader res;
 
 	if (!client->noack)
 	{
-		res = (ProtocolResponseHeader*)xmalloc(sizeof(*res));
+		set_response_header(&res, cmd, status, 0);
+
+		add_reply(client, &res, sizeof(res));
+	}
+}
+
+static uint32_t add_message_batch_response(EagleClient *client, int cmd, Queue_t *queue_t, uint32_t count)
+{
+	ProtocolResponseHeader res;
+	QueueIterator iterator;
+	Message *msg;
+	Object *object;
+	char *frame;
+	size_t length = sizeof(res) + sizeof(uint32_t);
+	size_t bodylen = sizeof(uint32_t);
+	size_t entry = sizeof(uint64_t) + sizeof(uint32_t);
+	size_t start = 0, pos;
+	uint32_t messages = 0, size, i;
+
+	rewind_messages_queue_t(queue_t, &iterator);
+	while (messages < count && (msg = queue_next_value(&iterator)) != NULL)
+	{
+		size = EG_MESSAGE_SIZE(msg);
+
+		if (messages && bodylen + entry + size > EG_MAX_BUF_SIZE) {
+			break;
+		}
 
-		set_response_header(res, cmd, status, 0);
+		bodylen += entry + size;
+		length += entry;
 
-		add_response(client, res, sizeof(*res));
+		if (size <= EG_REPLY_COPY_SIZE) {
+			length += size;
+		}
+
+		messages++;
 	}
+
+	frame = (char*)xmalloc(length);
+
+	set_response_header(&res, cmd, EG_PROTOCOL_STATUS_SUCCESS, bodylen);
+
+	memcpy(frame, &res, sizeof(res));
+	memcpy(frame + sizeof(res), &messages, sizeof(uint32_t));
+	pos = sizeof(res) + sizeof(uint32_t);
+
+	rewind_messages_queue_t(queue_t, &iterator);
+	for (i = 0; i < messages; i++)
+	{
+		msg = queue_next_value(&iterator);
+		object = EG_MESSAGE_OBJECT(msg);
+		size = EG_OBJECT_SIZE(object);
+
+		memcpy(frame + pos, &msg->tag, sizeof(uint64_t));
+		memcpy(frame + pos + sizeof(uint64_t), &size, sizeof(uint32_t));
+		pos += entry;
+
+		if (size <= EG_REPLY_COPY_SIZE)
+		{
+			memcpy(frame + pos, EG_OBJECT_DATA(object), size);
+			pos += size;
+		}
+		else
+		{
+			add_reply(client, frame + start, pos - start);
+			add_object_response(client, object);
+			start = pos;
+		}
+	}
+
+	if (!start) {
+		add_response(client, frame, length);
+		return messages;
+	}
+
+	if (pos > start) {
+		add_reply(client, frame + start, pos - start);
+	}
+
+	xfree(frame);
+
+	return messages;
 }
 
 static inline void parse_command(EagleClient *client, ProtocolRequestHeader* req)
@@ -1963,179 +2297,403 @@ static inline void parse_command(EagleClient *client, ProtocolRequestHeader* req
 	}
 }
 
-void process_request(EagleClient *client)
+static Object *create_request_object(EagleClient *client, size_t offset)
+{
+	Object *object = client->body;
+
+	if (!object) {
+		return create_dup_object(client->request + offset, client->pos - offset);
+	}
+
+	client->body = NULL;
+	shift_object(object, offset);
+
+	return object;
+}
+
+static int execute_request(EagleClient *client, char *request, size_t length)
+{
+	uint64_t aof_seq = server->aof_seq;
+
+	client->request = request;
+	client->pos = length;
+
+	parse_command(client, (ProtocolRequestHeader*)request);
+
+	if (server->aof_seq != aof_seq) {
+		client->aof_seq = server->aof_seq;
+	}
+
+	if (client->body) {
+		decrement_references_count(client->body);
+		client->body = NULL;
+	}
+
+	if (client->disconnect) {
+		free_client(client);
+		return EG_STATUS_ERR;
+	}
+
+	return EG_STATUS_OK;
+}
+
+static inline size_t get_max_request_size(void)
+{
+	if (server->max_request_size > 0 && server->max_request_size < EG_MAX_BUF_SIZE) {
+		return server->max_request_size;
+	}
+
+	return EG_MAX_BUF_SIZE;
+}
+
+int process_request(EagleClient *client)
 {
 	ProtocolRequestHeader *req;
+	size_t length;
 
-process:
-	if (!client->bodylen)
+	if (client->discard)
 	{
-		if (client->nread < sizeof(*req)) {
-			add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
-			return;
+		length = client->nread - client->offset;
+
+		if (length > client->discard) {
+			length = client->discard;
 		}
 
+		client->offset += length;
+		client->discard -= length;
+	}
+
+	while (client->nread - client->offset >= sizeof(*req))
+	{
 		req = (ProtocolRequestHeader*)(client->buffer + client->offset);
 
 		if (req->magic != EG_PROTOCOL_REQ)
 		{
 			client->offset = 0;
-			client->bodylen = 0;
+			client->nread = 0;
 			add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
-			return;
+			return EG_STATUS_OK;
 		}
 
-		if (req->bodylen > EG_MAX_BUF_SIZE)
+		length = sizeof(*req) + req->bodylen;
+
+		if (req->bodylen > get_max_request_size())
 		{
-			client->offset = 0;
-			client->bodylen = 0;
-			add_status_response(client, 0, EG_PROTOCOL_STATUS_ERROR_PACKET);
-			return;
-		}
+			add_status_response(client, req->cmd, EG_PROTOCOL_STATUS_ERROR_PACKET);
 
-		if (client->length < req->bodylen) {
-			client->request = xrealloc(client->request, EG_MAX_BUF_SIZE);
-			client->length = EG_MAX_BUF_SIZE;
-		}
+			client->discard = length;
+			length = client->nread - client->offset;
+
+			if (length > client->discard) {
+				length = client->discard;
+			}
 
-		int delta = client->nread - sizeof(*req);
+			client->offset += length;
+			client->discard -= length;
+			continue;
+		}
 
-		if (delta == (int)req->bodylen)
+		if (length > client->nread - client->offset)
 		{
-			memcpy(client->request, client->buffer + client->offset, client->nread);
-			client->pos = client->nread;
+			if (length <= EG_BUF_SIZE) {
+				break;
+			}
+
+			client->pos = client->nread - client->offset;
+			client->bodylen = length - client->pos;
+			client->body = create_buffer_object(length);
+
+			memcpy(EG_OBJECT_DATA(client->body), req, client->pos);
+
 			client->offset = 0;
 			client->nread = 0;
+			return EG_STATUS_OK;
 		}
-		else if (delta < (int)req->bodylen)
-		{
-			memcpy(client->request, client->buffer + client->offset, client->nread);
-			client->bodylen = req->bodylen - delta;
-			client->pos = client->nread;
-			return;
-		}
-		else if (delta > (int)req->bodylen)
-		{
-			client->pos = req->bodylen + sizeof(*req);
-			memcpy(client->request, client->buffer + client->offset, client->pos);
-			client->offset += client->pos;
-			client->nread -= client->pos;
+
+		client->offset += length;
+
+		if (execute_request(client, (char*)req, length) != EG_STATUS_OK) {
+			return EG_STATUS_ERR;
 		}
+	}
+
+	if (client->offset)
+	{
+		memmove(client->buffer, client->buffer + client->offset, client->nread - client->offset);
+		client->nread -= client->offset;
+		client->offset = 0;
+	}
+
+	return EG_STATUS_OK;
+}
+
+static int read_client_data(EagleClient *client)
+{
+	int status = EG_CLIENT_IO_DONE;
+	size_t size;
+	ssize_t nread;
+
+	if (client->body) {
+		size = client->bodylen;
+		nread = read(client->fd, (char*)EG_OBJECT_DATA(client->body) + client->pos, size);
 	} else {
-		if (client->nread == client->bodylen)
-		{
-			memcpy(client->request + client->pos, client->buffer, client->nread);
-			client->pos += client->nread;
-			client->offset = 0;
-			client->nread = 0;
-			client->bodylen = 0;
+		if (!client->buffer) {
+			client->buffer = (char*)xarena_alloc(EG_BUF_SIZE);
 		}
-		else if (client->nread < client->bodylen)
-		{
-			memcpy(client->request + client->pos, client->buffer, client->nread);
-			client->pos += client->nread;
-			client->bodylen -= client->nread;
-			client->offset = 0;
-			return;
+
+		size = EG_BUF_SIZE - client->nread;
+		nread = read(client->fd, client->buffer + client->nread, size);
+	}
+
+	server->read_calls++;
+
+	if (nread == -1) {
+		if (errno != EAGAIN) {
+			free_client(client);
+			return EG_CLIENT_IO_CLOSED;
 		}
-		else if (client->nread > client->bodylen)
-		{
-			memcpy(client->request + client->pos, client->buffer, client->bodylen);
-			client->pos += client->bodylen;
-			client->nread -= client->bodylen;
-			client->offset = client->bodylen;
-			client->bodylen = 0;
+		return EG_CLIENT_IO_DONE;
+	} else if (nread == 0) {
+		free_client(client);
+		return EG_CLIENT_IO_CLOSED;
+	}
+
+	client->last_action = time(NULL);
+
+	/* in edge-triggered mode a full read may leave data behind that will not be reported again */
+	if (server->edge_triggered && (size_t)nread == size) {
+		status = EG_CLIENT_IO_AGAIN;
+	}
+
+	if (client->body)
+	{
+		client->pos += nread;
+		client->bodylen -= nread;
+
+		if (client->bodylen == 0 &&
+			execute_request(client, EG_OBJECT_DATA(client->body), EG_OBJECT_SIZE(client->body)) != EG_STATUS_OK) {
+			return EG_CLIENT_IO_CLOSED;
 		}
+
+		return status;
 	}
 
-	req = (ProtocolRequestHeader*)client->request;
-	parse_command(client, req);
+	client->nread += nread;
 
-	if ((int)client->nread >= (int)sizeof(*req)) {
-		goto process;
+	if (process_request(client) != EG_STATUS_OK) {
+		return EG_CLIENT_IO_CLOSED;
+	}
+
+	return status;
+}
+
+static void add_pending_client(EagleClient *client, List *list, int flag)
+{
+	if (!(client->pending & flag))
+	{
+		client->pending |= flag;
+		list_add_value_tail(list, client);
+	}
+}
+
+static void delete_pending_client(EagleClient *client, List *list, int flag)
+{
+	if (client->pending & flag)
+	{
+		client->pending &= ~flag;
+		list_delete_value(list, client);
 	}
 }
 
 void read_request(EventLoop *loop, int fd, void *data, int mask)
 {
 	EagleClient *client = (EagleClient*)data;
-	int nread;
 
 	EG_NOTUSED(loop);
+	EG_NOTUSED(fd);
 	EG_NOTUSED(mask);
 
-	nread = read(fd, client->buffer, EG_BUF_SIZE);
+	while (read_client_data(client) == EG_CLIENT_IO_AGAIN);
+}
 
-	if (nread == -1) {
-		if (errno == EAGAIN) {
-			nread = 0;
-		} else {
-			free_client(client);
-			return;
-		}
-	} else if (nread == 0) {
-		free_client(client);
-		return;
+static int get_response_iov(EagleClient *client, struct iovec *iov, size_t *length)
+{
+	ListIterator iterator;
+	ListNode *node;
+	Object *object;
+	size_t offset = client->sentlen;
+	int count = 0;
+
+	*length = 0;
+
+	if (client->replylen)
+	{
+		iov[count].iov_base = client->reply + client->replysent;
+		iov[count].iov_len = client->replylen - client->replysent;
+		*length += iov[count].iov_len;
+		count++;
 	}
 
-	if (nread) {
-		client->nread = nread;
-		client->last_action = time(NULL);
-	} else {
-		return;
+	list_rewind(client->responses, &iterator);
+	while (count < EG_MAX_IOV && (node = list_next_node(&iterator)) != NULL)
+	{
+		object = EG_LIST_NODE_VALUE(node);
+
+		iov[count].iov_base = (char*)EG_OBJECT_DATA(object) + offset;
+		iov[count].iov_len = EG_OBJECT_SIZE(object) - offset;
+		*length += iov[count].iov_len;
+
+		offset = 0;
+		count++;
 	}
 
-	process_request(client);
+	return count;
 }
 
-static void send_response(EventLoop *loop, int fd, void *data, int mask)
+static void advance_response(EagleClient *client, size_t nwritten)
 {
-	EagleClient *client = data;
 	Object *object;
-	int nwritten = 0, totwritten = 0;
+	size_t left;
 
-	EG_NOTUSED(loop);
-	EG_NOTUSED(mask);
+	if (client->replylen)
+	{
+		left = client->replylen - client->replysent;
+
+		if (nwritten < left) {
+			client->replysent += nwritten;
+			return;
+		}
+
+		nwritten -= left;
+		client->replylen = 0;
+		client->replysent = 0;
+	}
 
 	while (EG_LIST_LENGTH(client->responses))
 	{
 		object = EG_LIST_NODE_VALUE(EG_LIST_FIRST(client->responses));
+		left = EG_OBJECT_SIZE(object) - client->sentlen;
 
-		if (EG_OBJECT_SIZE(object) == 0) {
-			list_delete_node(client->responses, EG_LIST_FIRST(client->responses));
-			continue;
+		if (nwritten < left) {
+			client->sentlen += nwritten;
+			break;
 		}
 
-		nwritten = write(fd, ((char*)EG_OBJECT_DATA(object)) + client->sentlen, EG_OBJECT_SIZE(object) - client->sentlen);
-		if (nwritten <= 0) {
-			break;
+		nwritten -= left;
+		client->sentlen = 0;
+		list_delete_node(client->responses, EG_LIST_FIRST(client->responses));
+	}
+}
+
+static int write_client_data(EagleClient *client)
+{
+	struct iovec iov[EG_MAX_IOV];
+	ssize_t nwritten = 0;
+	size_t length;
+	int count, mask;
+
+	count = get_response_iov(client, iov, &length);
+
+	if (length)
+	{
+		nwritten = writev(client->fd, iov, count);
+		server->write_calls++;
+
+		if (nwritten == -1) {
+			if (errno != EAGAIN) {
+				free_client(client);
+				return EG_CLIENT_IO_CLOSED;
+			}
+		} else if (nwritten > 0) {
+			advance_response(client, nwritten);
+			client->last_action = time(NULL);
 		}
+	}
+
+	mask = get_file_events(server->loop, client->fd);
 
-		client->sentlen += nwritten;
-		totwritten += nwritten;
+	if (client->replylen == 0 && EG_LIST_LENGTH(client->responses) == 0)
+	{
+		client->sentlen = 0;
 
-		if (client->sentlen == EG_OBJECT_SIZE(object)) {
-			list_delete_node(client->responses, EG_LIST_FIRST(client->responses));
-			client->sentlen = 0;
+		if (mask & EG_EVENT_WRITABLE) {
+			delete_file_event(server->loop, client->fd, EG_EVENT_WRITABLE);
 		}
+
+		return EG_CLIENT_IO_DONE;
 	}
 
-	if (nwritten == -1) {
-		if (errno == EAGAIN) {
-			nwritten = 0;
-		} else {
+	if (nwritten > 0 && (size_t)nwritten == length) {
+		return EG_CLIENT_IO_AGAIN;
+	}
+
+	if (!(mask & EG_EVENT_WRITABLE))
+	{
+		mask = server->edge_triggered ? (EG_EVENT_WRITABLE|EG_EVENT_EDGE) : EG_EVENT_WRITABLE;
+
+		if (create_file_event(server->loop, client->fd, mask, send_response, client) == EG_EVENT_ERR) {
 			free_client(client);
-			return;
+			return EG_CLIENT_IO_CLOSED;
 		}
 	}
 
-	if (totwritten > 0) {
-		client->last_action = time(NULL);
+	return EG_CLIENT_IO_DONE;
+}
+
+static inline int check_client_aof(EagleClient *client)
+{
+	return server->aof_fsync != EG_AOF_FSYNC_ALWAYS || client->aof_seq <= server->aof_flushed_seq;
+}
+
+static void free_unlogged_clients(void)
+{
+	EagleClient *client;
+	ListIterator iterator;
+	ListNode *node;
+
+	list_rewind(server->pending_writes, &iterator);
+	while ((node = list_next_node(&iterator)) != NULL)
+	{
+		client = EG_LIST_NODE_VALUE(node);
+
+		if (!check_client_aof(client)) {
+			free_client(client);
+		}
 	}
+}
 
-	if (EG_LIST_LENGTH(client->responses) == 0) {
-		client->sentlen = 0;
-		delete_file_event(server->loop, client->fd, EG_EVENT_WRITABLE);
+static void send_response(EventLoop *loop, int fd, void *data, int mask)
+{
+	EagleClient *client = data;
+
+	EG_NOTUSED(loop);
+	EG_NOTUSED(fd);
+	EG_NOTUSED(mask);
+
+	if (aof_flush() != EG_STATUS_OK && !check_client_aof(client)) {
+		free_client(client);
+		return;
+	}
+
+	while (write_client_data(client) == EG_CLIENT_IO_AGAIN);
+}
+
+void process_pending_clients(void)
+{
+	EagleClient *client;
+
+	if (aof_flush() != EG_STATUS_OK) {
+		free_unlogged_clients();
+	}
+
+	while (EG_LIST_LENGTH(server->pending_writes))
+	{
+		client = EG_LIST_NODE_VALUE(EG_LIST_FIRST(server->pending_writes));
+
+		list_delete_node(server->pending_writes, EG_LIST_FIRST(server->pending_writes));
+		client->pending &= ~EG_CLIENT_PENDING_WRITE;
+
+		while (write_client_data(client) == EG_CLIENT_IO_AGAIN);
 	}
 }
 
@@ -2158,28 +2716,81 @@ void client_timeout(void)
 	}
 }
 
+void release_idle_client_buffers(void)
+{
+	EagleClient *client;
+	ListIterator iterator;
+	ListNode *node;
+
+	list_rewind(server->clients, &iterator);
+	while ((node = list_next_node(&iterator)) != NULL)
+	{
+		client = EG_LIST_NODE_VALUE(node);
+
+		if ((server->now_time - client->last_action) < EG_CLIENT_IDLE_TIME || client->pending) {
+			continue;
+		}
+
+		if (client->buffer && client->nread == 0) {
+			xarena_free(client->buffer, EG_BUF_SIZE);
+			client->buffer = NULL;
+		}
+
+		if (client->reply && client->replylen == 0) {
+			xarena_free(client->reply, EG_REPLY_SIZE);
+			client->reply = NULL;
+		}
+	}
+}
+
+size_t get_client_memory(void)
+{
+	EagleClient *client;
+	ListIterator iterator;
+	ListNode *node;
+	size_t memory = 0;
+
+	list_rewind(server->clients, &iterator);
+	while ((node = list_next_node(&iterator)) != NULL)
+	{
+		client = EG_LIST_NODE_VALUE(node);
+
+		if (client->buffer) {
+			memory += EG_BUF_SIZE;
+		}
+
+		if (client->reply) {
+			memory += EG_REPLY_SIZE;
+		}
+
+		if (client->body) {
+			memory += EG_OBJECT_SIZE(client->body);
+		}
+	}
+
+	return memory;
+}
+
 static int set_write_event(EagleClient *client)
 {
 	if (client->fd <= 0) {
 		return EG_STATUS_ERR;
 	}
 
-	if (create_file_event(server->loop, client->fd, EG_EVENT_WRITABLE, send_response, client) == EG_EVENT_ERR &&
-			EG_LIST_LENGTH(client->responses) == 0) {
-		return EG_STATUS_ERR;
-	}
+	add_pending_client(client, server->pending_writes, EG_CLIENT_PENDING_WRITE);
 
-    return EG_STATUS_OK;
+	return EG_STATUS_OK;
 }
 
 EagleClient *create_client(int fd)
 {
 	EagleClient *client = (EagleClient*)xmalloc(sizeof(*client));
 
-	net_set_nonblock(NULL, fd);
+	int mask = server->edge_triggered ? (EG_EVENT_READABLE|EG_EVENT_EDGE) : EG_EVENT_READABLE;
+
 	net_tcp_nodelay(NULL, fd);
 
-	if (create_file_event(server->loop, fd, EG_EVENT_READABLE, read_request, client) == EG_EVENT_ERR) {
+	if (create_file_event(server->loop, fd, mask, read_request, client) == EG_EVENT_ERR) {
 		close(fd);
 		xfree(client);
 		return NULL;
@@ -2187,20 +2798,27 @@ EagleClient *create_client(int fd)
 
 	client->fd = fd;
 	client->perm = 0;
-	client->request = (char*)xmalloc(EG_BUF_SIZE);
-	client->length = EG_BUF_SIZE;
+	client->request = NULL;
 	client->pos = 0;
 	client->noack = 0;
+	client->disconnect = 0;
+	client->body = NULL;
 	client->offset = 0;
-	client->buffer = (char*)xmalloc(EG_BUF_SIZE);
+	client->buffer = NULL;
 	client->bodylen = 0;
+	client->discard = 0;
 	client->nread = 0;
+	client->reply = NULL;
+	client->replylen = 0;
+	client->replysent = 0;
 	client->responses = list_create();
-	client->declared_queues = list_create();
-	client->subscribed_queues = list_create();
+	client->declared_queues = dict_create();
+	client->subscribed_queues = dict_create();
 	client->subscribed_topics = keylist_create();
 	client->subscribed_patterns = keylist_create();
 	client->sentlen = 0;
+	client->pending = 0;
+	client->aof_seq = 0;
 	client->last_action = time(NULL);
 
 	EG_LIST_SET_FREE_METHOD(client->responses, free_object_list_handler);
@@ -2212,20 +2830,25 @@ EagleClient *create_client(int fd)
 
 void free_client(EagleClient *client)
 {
-	xfree(client->request);
-	xfree(client->buffer);
+	if (client->body) {
+		decrement_references_count(client->body);
+	}
+
+	xarena_free(client->buffer, EG_BUF_SIZE);
+	xarena_free(client->reply, EG_REPLY_SIZE);
+
+	delete_pending_client(client, server->pending_writes, EG_CLIENT_PENDING_WRITE);
 
 	eject_queue_client(client);
 	eject_channel_client(client);
 
 	list_release(client->responses);
-	list_release(client->declared_queues);
-	list_release(client->subscribed_queues);
+	dict_release(client->declared_queues);
+	dict_release(client->subscribed_queues);
 	keylist_release(client->subscribed_topics);
 	keylist_release(client->subscribed_patterns);
 
-	delete_file_event(server->loop, client->fd, EG_EVENT_READABLE);
-	delete_file_event(server->loop, client->fd, EG_EVENT_WRITABLE);
+	delete_file_event(server->loop, client->fd, EG_EVENT_READABLE|EG_EVENT_WRITABLE|EG_EVENT_EDGE);
 
 	close(client->fd);
 
@@ -2236,37 +2859,46 @@ void free_client(EagleClient *client)
 
 void accept_tcp_handler(EventLoop *loop, int fd, void *data, int mask)
 {
-	int port, cfd;
-	char ip[128];
+	int cfd, max = EG_MAX_ACCEPTS_PER_CALL;
 
 	EG_NOTUSED(loop);
 	EG_NOTUSED(mask);
 	EG_NOTUSED(data);
 
-	cfd = net_tcp_accept(server->error, fd, ip, &port);
-	if (cfd == EG_NET_ERR) {
-		warning("Error accept client: %s", server->error);
-		return;
-	}
+	while (max--)
+	{
+		cfd = net_tcp_accept(server->error, fd, NULL, NULL);
+		if (cfd == EG_NET_ERR) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				warning("Error accept client: %s", server->error);
+			}
+			return;
+		}
 
-	accept_common_handler(cfd);
+		accept_common_handler(cfd);
+	}
 }
 
 void accept_unix_handler(EventLoop *loop, int fd, void *data, int mask)
 {
-	int cfd;
+	int cfd, max = EG_MAX_ACCEPTS_PER_CALL;
 
 	EG_NOTUSED(loop);
 	EG_NOTUSED(mask);
 	EG_NOTUSED(data);
 
-	cfd = net_unix_accept(server->error, fd);
-	if (cfd == EG_NET_ERR) {
-		warning("Accepting client connection: %s", server->error);
-		return;
-	}
+	while (max--)
+	{
+		cfd = net_unix_accept(server->error, fd);
+		if (cfd == EG_NET_ERR) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				warning("Accepting client connection: %s", server->error);
+			}
+			return;
+		}
 
-	accept_common_handler(cfd);
+		accept_common_handler(cfd);
+	}
 }
 
 static void accept_common_handler(int fd)
@@ -2274,7 +2906,6 @@ static void accept_common_handler(int fd)
 	EagleClient *client;
 
 	if ((client = create_client(fd)) == NULL) {
-		close(fd);
 		return;
 	}
 
@@ -39,9 +39,12 @@ void queue_client_event_message(EagleClient *client, Queue_t *queue_t, Message *
 void channel_client_event_message(EagleClient *client, Channel_t *channel, const char *topic, Object *msg);
 void channel_client_event_pattern_message(EagleClient *client, Channel_t *channel,
 	const char *topic, const char *pattern, Object *msg);
-void process_request(EagleClient *client);
+int process_request(EagleClient *client);
 void read_request(EventLoop *loop, int fd, void *data, int mask);
+void process_pending_clients(void);
 void client_timeout(void);
+void release_idle_client_buffers(void);
+size_t get_client_memory(void);
 EagleClient *create_client(int fd);
 void free_client(EagleClient *client);
 void accept_tcp_handler(EventLoop *loop, int fd, void *data, int mask);
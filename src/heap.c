@@ -0,0 +1,206 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+
+#include "heap.h"
+#include "xmalloc.h"
+
+#define heap_parent(i) (((i) - 1) / 2)
+#define heap_left(i) (2 * (i) + 1)
+
+static void heap_resize(Heap *heap, unsigned long size);
+static void heap_sift_up(Heap *heap, unsigned long index);
+static void heap_sift_down(Heap *heap, unsigned long index);
+
+Heap *heap_create(void)
+{
+	Heap *heap;
+
+	heap = (Heap*)xmalloc(sizeof(*heap));
+
+	heap->entries = NULL;
+	heap->size = 0;
+	heap->len = 0;
+	heap->index = NULL;
+	heap->free = NULL;
+
+	return heap;
+}
+
+void heap_release(Heap *heap)
+{
+	heap_empty(heap);
+
+	xfree(heap);
+}
+
+void heap_empty(Heap *heap)
+{
+	unsigned long i;
+
+	if (heap->free)
+	{
+		for (i = 0; i < heap->len; i++) {
+			heap->free(heap->entries[i].value);
+		}
+	}
+
+	xfree(heap->entries);
+
+	heap->entries = NULL;
+	heap->size = 0;
+	heap->len = 0;
+}
+
+void heap_push(Heap *heap, uint64_t key, void *value)
+{
+	if (heap->len == heap->size) {
+		heap_resize(heap, heap->size ? heap->size * 2 : EG_HEAP_MIN_SIZE);
+	}
+
+	heap->entries[heap->len].key = key;
+	heap->entries[heap->len].value = value;
+
+	heap_sift_up(heap, heap->len++);
+}
+
+void *heap_pop(Heap *heap)
+{
+	if (!heap->len) {
+		return NULL;
+	}
+
+	return heap_delete(heap, 0);
+}
+
+void *heap_delete(Heap *heap, unsigned long index)
+{
+	void *value = heap->entries[index].value;
+
+	heap->len--;
+
+	if (index != heap->len)
+	{
+		heap->entries[index] = heap->entries[heap->len];
+
+		if (index && heap->entries[index].key < heap->entries[heap_parent(index)].key) {
+			heap_sift_up(heap, index);
+		} else {
+			heap_sift_down(heap, index);
+		}
+	}
+
+	if (heap->index) {
+		heap->index(value, EG_HEAP_NO_INDEX);
+	}
+
+	if (heap->size > EG_HEAP_MIN_SIZE && heap->len < heap->size / 4) {
+		heap_resize(heap, heap->size / 2);
+	}
+
+	return value;
+}
+
+void heap_update(Heap *heap, unsigned long index, uint64_t key)
+{
+	uint64_t old = heap->entries[index].key;
+
+	heap->entries[index].key = key;
+
+	if (key < old) {
+		heap_sift_up(heap, index);
+	} else if (key > old) {
+		heap_sift_down(heap, index);
+	}
+}
+
+static void heap_resize(Heap *heap, unsigned long size)
+{
+	heap->entries = (HeapEntry*)xrealloc(heap->entries, sizeof(HeapEntry) * size);
+	heap->size = size;
+}
+
+static void heap_sift_up(Heap *heap, unsigned long index)
+{
+	HeapEntry entry = heap->entries[index];
+	unsigned long parent;
+
+	while (index > 0)
+	{
+		parent = heap_parent(index);
+
+		if (heap->entries[parent].key <= entry.key) {
+			break;
+		}
+
+		heap->entries[index] = heap->entries[parent];
+
+		if (heap->index) {
+			heap->index(heap->entries[index].value, index);
+		}
+
+		index = parent;
+	}
+
+	heap->entries[index] = entry;
+
+	if (heap->index) {
+		heap->index(entry.value, index);
+	}
+}
+
+static void heap_sift_down(Heap *heap, unsigned long index)
+{
+	HeapEntry entry = heap->entries[index];
+	unsigned long child;
+
+	while ((child = heap_left(index)) < heap->len)
+	{
+		if (child + 1 < heap->len && heap->entries[child + 1].key < heap->entries[child].key) {
+			child++;
+		}
+
+		if (entry.key <= heap->entries[child].key) {
+			break;
+		}
+
+		heap->entries[index] = heap->entries[child];
+
+		if (heap->index) {
+			heap->index(heap->entries[index].value, index);
+		}
+
+		index = child;
+	}
+
+	heap->entries[index] = entry;
+
+	if (heap->index) {
+		heap->index(entry.value, index);
+	}
+}
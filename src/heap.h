@@ -0,0 +1,69 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HEAP_LIB_H__
+#define __HEAP_LIB_H__
+
+#include <stdint.h>
+
+#define EG_HEAP_MIN_SIZE 16
+#define EG_HEAP_NO_INDEX ((unsigned long)-1)
+
+#define EG_HEAP_LENGTH(h) ((h)->len)
+#define EG_HEAP_TOP_KEY(h) ((h)->entries[0].key)
+#define EG_HEAP_TOP_VALUE(h) ((h)->entries[0].value)
+#define EG_HEAP_ENTRY_KEY(h, i) ((h)->entries[i].key)
+#define EG_HEAP_ENTRY_VALUE(h, i) ((h)->entries[i].value)
+
+#define EG_HEAP_SET_INDEX_METHOD(h, m) ((h)->index = (m))
+#define EG_HEAP_SET_FREE_METHOD(h, m) ((h)->free = (m))
+
+#define EG_HEAP_GET_INDEX_METHOD(h) ((h)->index)
+#define EG_HEAP_GET_FREE_METHOD(h) ((h)->free)
+
+typedef struct HeapEntry {
+	uint64_t key;
+	void *value;
+} HeapEntry;
+
+typedef struct Heap {
+	HeapEntry *entries;
+	unsigned long size;
+	unsigned long len;
+	void (*index)(void *value, unsigned long index);
+	void (*free)(void *value);
+} Heap;
+
+Heap *heap_create(void);
+void heap_release(Heap *heap);
+void heap_empty(Heap *heap);
+void heap_push(Heap *heap, uint64_t key, void *value);
+void *heap_pop(Heap *heap);
+void *heap_delete(Heap *heap, unsigned long index);
+void heap_update(Heap *heap, unsigned long index, uint64_t key);
+
+#endif
@@ -29,6 +29,7 @@
 
 #include "eagle.h"
 #include "keylist.h"
+#include "dict.h"
 #include "xmalloc.h"
 
 Keylist *keylist_create(void)
@@ -38,6 +39,7 @@ Keylist *keylist_create(void)
 	keylist = (Keylist*)xmalloc(sizeof(*keylist));
 
 	keylist->head = keylist->tail = NULL;
+	keylist->index = dict_create();
 	keylist->len = 0;
 	keylist->free = NULL;
 	keylist->match = NULL;
@@ -64,29 +66,13 @@ void keylist_release(Keylist *keylist)
 		current = next;
 	}
 
+	dict_release(keylist->index);
 	xfree(keylist);
 }
 
 KeylistNode *keylist_get_value(Keylist *keylist, void *key)
 {
-	KeylistIterator iter;
-	KeylistNode *node;
-
-	keylist_rewind(keylist, &iter);
-	while ((node = keylist_next_node(&iter)) != NULL)
-	{
-		if (keylist->match) {
-			if (keylist->match(node->key, key)) {
-				return node;
-			}
-		} else {
-			if (node->key == key) {
-				return node;
-			}
-		}
-	}
-
-	return NULL;
+	return dict_fetch_value(keylist->index, key);
 }
 
 Keylist *keylist_set_value(Keylist *keylist, void *key, void *value)
@@ -113,6 +99,8 @@ Keylist *keylist_set_value(Keylist *keylist, void *key, void *value)
 		keylist->tail = node;
 	}
 
+	dict_add(keylist->index, key, node);
+
 	keylist->len++;
 
 	return keylist;
@@ -120,6 +108,8 @@ Keylist *keylist_set_value(Keylist *keylist, void *key, void *value)
 
 void keylist_delete_node(Keylist *keylist, KeylistNode *node)
 {
+	dict_delete(keylist->index, node->key);
+
 	if (node->prev) {
 		node->prev->next = node->next;
 	} else {
@@ -28,6 +28,8 @@
 #ifndef __KEYLIST_LIB_H__
 #define __KEYLIST_LIB_H__
 
+#include "dict.h"
+
 #define EG_KEYLIST_LENGTH(l) ((l)->len)
 #define EG_KEYLIST_FIRST(l) ((l)->head)
 #define EG_KEYLIST_LAST(l) ((l)->tail)
@@ -36,9 +38,11 @@
 #define EG_KEYLIST_NODE_KEY(n) ((n)->key)
 #define EG_KEYLIST_NODE_VALUE(n) ((n)->value)
 
+#define EG_KEYLIST_SET_HASH_METHOD(l, m) EG_DICT_SET_HASH_METHOD((l)->index, (m))
 #define EG_KEYLIST_SET_FREE_METHOD(l, m) ((l)->free = (m))
-#define EG_KEYLIST_SET_MATCH_METHOD(l, m) ((l)->match = (m))
+#define EG_KEYLIST_SET_MATCH_METHOD(l, m) ((l)->match = (m), EG_DICT_SET_MATCH_METHOD((l)->index, (m)))
 
+#define EG_KEYLIST_GET_HASH_METHOD(l) EG_DICT_GET_HASH_METHOD((l)->index)
 #define EG_KEYLIST_GET_FREE_METHOD(l) ((l)->free)
 #define EG_KEYLIST_GET_MATCH_METHOD(l) ((l)->match)
 
@@ -56,6 +60,7 @@ typedef struct KeylistIterator {
 typedef struct Keylist {
 	KeylistNode *head;
 	KeylistNode *tail;
+	Dict *index;
 	void (*free)(void *key, void *value);
 	int (*match)(void *key1, void *key2);
 	unsigned int len;
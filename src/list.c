@@ -60,7 +60,7 @@ void list_release(List *list)
 			list->free(current->value);
 		}
 
-		xfree(current);
+		xslab_free(current, sizeof(*current));
 		current = next;
 	}
 
@@ -71,7 +71,7 @@ List *list_add_value_head(List *list, void *value)
 {
 	ListNode *node;
 
-	node = (ListNode*)xmalloc(sizeof(*node));
+	node = (ListNode*)xslab_alloc(sizeof(*node));
 
 	node->value = value;
 
@@ -94,7 +94,7 @@ List *list_add_value_tail(List *list, void *value)
 {
 	ListNode *node;
 
-	node = (ListNode*)xmalloc(sizeof(*node));
+	node = (ListNode*)xslab_alloc(sizeof(*node));
 
 	node->value = value;
 
@@ -146,7 +146,7 @@ void list_delete_node(List *list, ListNode *node)
 		list->free(node->value);
 	}
 
-	xfree(node);
+	xslab_free(node, sizeof(*node));
 	list->len--;
 }
 
@@ -34,7 +34,7 @@
 
 Message *create_message(Object *data, uint64_t tag, uint32_t expiration)
 {
-	Message *msg = (Message*)xcalloc(sizeof(*msg));
+	Message *msg = (Message*)xslab_calloc(sizeof(*msg));
 
 	msg->value = data;
 	msg->tag = tag;
@@ -47,7 +47,7 @@ Message *create_message(Object *data, uint64_t tag, uint32_t expiration)
 void release_message(Message *msg)
 {
 	decrement_references_count(msg->value);
-	xfree(msg);
+	xslab_free(msg, sizeof(*msg));
 }
 
 void free_message_list_handler(void *ptr)
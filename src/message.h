@@ -37,8 +37,11 @@
 #define EG_MESSAGE_VALUE(m) ((m)->value->data)
 #define EG_MESSAGE_SIZE(m) ((m)->value->size)
 
-#define EG_MESSAGE_GET_DATA(m, i) ((m)->data[i])
-#define EG_MESSAGE_SET_DATA(m, i, v) ((m)->data[i] = (v))
+#define EG_MESSAGE_GET_TIMER(m) ((m)->timer)
+#define EG_MESSAGE_SET_TIMER(m, v) ((m)->timer = (v))
+
+#define EG_MESSAGE_GET_POSITION(m) ((m)->position)
+#define EG_MESSAGE_SET_POSITION(m, v) ((m)->position = (v))
 
 #define EG_MESSAGE_GET_TAG(m) ((m)->tag)
 #define EG_MESSAGE_SET_TAG(m, v) ((m)->tag = (v))
@@ -54,7 +57,8 @@ typedef struct Message {
 	uint64_t tag;
 	uint32_t confirm;
 	uint32_t expiration;
-	void *data[2];
+	uint64_t position;
+	unsigned long timer;
 } Message;
 
 Message *create_message(Object *data, uint64_t tag, uint32_t expiration);
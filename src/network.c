@@ -83,15 +83,15 @@ int net_set_nonblock(char *err, int fd)
 
 	if ((flags = fcntl(fd, F_GETFL)) == -1) {
 		net_set_error(err, "fcntl: %s", strerror(errno));
-		return EG_NET_OK;
+		return EG_NET_ERR;
 	}
 
 	if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
 		net_set_error(err, "fcntl: %s", strerror(errno));
-        return EG_NET_ERR;
+		return EG_NET_ERR;
 	}
 
-	return EG_NET_ERR;
+	return EG_NET_OK;
 }
 
 int net_tcp_nodelay(char *err, int fd)
@@ -182,7 +182,11 @@ static int net_generic_accept(char *err, int sock, struct sockaddr *sa, socklen_
 
 	while (1)
 	{
+#ifdef SOCK_NONBLOCK
+		fd = accept4(sock, sa, len, SOCK_NONBLOCK);
+#else
 		fd = accept(sock, sa, len);
+#endif
 		if (fd == -1)
 		{
 			if (errno == EINTR) {
@@ -195,6 +199,10 @@ static int net_generic_accept(char *err, int sock, struct sockaddr *sa, socklen_
 		break;
 	}
 
+#ifndef SOCK_NONBLOCK
+	net_set_nonblock(NULL, fd);
+#endif
+
 	return fd;
 }
 
@@ -34,32 +34,53 @@
 
 Object *create_object(void *ptr, size_t size)
 {
-	Object *object = (Object*)xmalloc(sizeof(*object));
+	Object *object = (Object*)xslab_alloc(sizeof(*object));
 
 	object->data = ptr;
 	object->size = size;
 	object->refcount = 1;
+	object->offset = 0;
 
 	return object;
 }
 
-Object *create_dup_object(void *ptr, size_t size)
+Object *create_buffer_object(size_t size)
 {
-	Object *object = (Object*)xmalloc(sizeof(*object));
+	Object *object = (Object*)xslab_alloc(sizeof(*object) + size);
 
-	object->data = xmalloc(size);
+	object->data = object->buffer;
 	object->size = size;
 	object->refcount = 1;
+	object->offset = 0;
+
+	return object;
+}
+
+Object *create_dup_object(void *ptr, size_t size)
+{
+	Object *object = create_buffer_object(size);
 
 	memcpy(object->data, ptr, size);
 
 	return object;
 }
 
+void shift_object(Object *object, size_t offset)
+{
+	object->data = (char*)object->data + offset;
+	object->size -= offset;
+	object->offset += offset;
+}
+
 void release_object(Object *object)
 {
+	if (EG_OBJECT_IS_INLINE(object)) {
+		xslab_free(object, sizeof(*object) + object->offset + object->size);
+		return;
+	}
+
 	xfree(object->data);
-	xfree(object);
+	xslab_free(object, sizeof(*object));
 }
 
 void increment_references_count(Object *object)
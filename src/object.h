@@ -34,16 +34,20 @@
 
 #define EG_OBJECT_SIZE(x) ((x)->size)
 #define EG_OBJECT_DATA(x) ((x)->data)
-#define EG_OBJECT_RESET_REFCOUNT(x) ((x)->refcount = 0)
+#define EG_OBJECT_IS_INLINE(x) ((x)->data == (x)->buffer + (x)->offset)
 
 typedef struct Object {
 	void *data;
 	size_t size;
 	unsigned int refcount;
+	unsigned int offset;
+	char buffer[];
 } Object;
 
 Object *create_object(void *ptr, size_t size);
+Object *create_buffer_object(size_t size);
 Object *create_dup_object(void *ptr, size_t size);
+void shift_object(Object *object, size_t offset);
 void release_object(Object *object);
 void increment_references_count(Object *object);
 void decrement_references_count(Object *object);
@@ -0,0 +1,519 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "eagle.h"
+#include "pattern.h"
+#include "list.h"
+#include "xmalloc.h"
+
+typedef struct PatternToken {
+	int type;
+	unsigned char symbol;
+	const char *text;
+	int length;
+} PatternToken;
+
+static int pattern_next_token(const char *pattern, int length, int pos, PatternToken *token);
+static PatternNode *pattern_create_node(PatternToken *token, PatternNode *parent);
+static void pattern_free_node(PatternNode *node);
+static PatternNode *pattern_find_literal(PatternNode *node, unsigned char symbol, unsigned int *pos);
+static PatternNode *pattern_find_child(PatternNode *node, PatternToken *token);
+static PatternNode *pattern_add_child(PatternNode *node, PatternToken *token);
+static void pattern_remove_child(PatternNode *node, PatternNode *child);
+static PatternNode *pattern_find_node(PatternTrie *trie, const char *pattern);
+static int pattern_match_class(PatternNode *node, unsigned char symbol);
+static void pattern_match_node(PatternTrie *trie, PatternNode *node, const char *string, int length,
+	pattern_handler *handler, void *data);
+
+PatternTrie *pattern_trie_create(void)
+{
+	PatternTrie *trie;
+	PatternToken token;
+
+	trie = (PatternTrie*)xmalloc(sizeof(*trie));
+
+	token.type = EG_PATTERN_LITERAL;
+	token.symbol = 0;
+	token.text = NULL;
+	token.length = 0;
+
+	trie->root = pattern_create_node(&token, NULL);
+	trie->stamp = 0;
+	trie->len = 0;
+
+	return trie;
+}
+
+void pattern_trie_release(PatternTrie *trie)
+{
+	pattern_free_node(trie->root);
+
+	xfree(trie);
+}
+
+int pattern_trie_insert(PatternTrie *trie, const char *pattern, void *value)
+{
+	PatternToken token;
+	PatternNode *node = trie->root;
+	int length = strlen(pattern);
+	int pos = 0;
+
+	while (pos < length)
+	{
+		pos = pattern_next_token(pattern, length, pos, &token);
+		node = pattern_add_child(node, &token);
+	}
+
+	if (!node->values) {
+		node->values = list_create();
+	} else if (list_search_node(node->values, value)) {
+		return EG_STATUS_ERR;
+	}
+
+	list_add_value_tail(node->values, value);
+	trie->len++;
+
+	while (node) {
+		node->patterns++;
+		node = node->parent;
+	}
+
+	return EG_STATUS_OK;
+}
+
+int pattern_trie_delete(PatternTrie *trie, const char *pattern, void *value)
+{
+	PatternNode *node, *parent;
+
+	node = pattern_find_node(trie, pattern);
+	if (!node || list_delete_value(node->values, value) == EG_STATUS_ERR) {
+		return EG_STATUS_ERR;
+	}
+
+	if (!EG_LIST_LENGTH(node->values)) {
+		list_release(node->values);
+		node->values = NULL;
+	}
+
+	trie->len--;
+
+	while (node)
+	{
+		parent = node->parent;
+
+		node->patterns--;
+
+		if (parent && node->patterns == 0) {
+			pattern_remove_child(parent, node);
+			pattern_free_node(node);
+		}
+
+		node = parent;
+	}
+
+	return EG_STATUS_OK;
+}
+
+void pattern_trie_match(PatternTrie *trie, const char *string, pattern_handler *handler, void *data)
+{
+	if (trie->len == 0) {
+		return;
+	}
+
+	trie->stamp++;
+
+	pattern_match_node(trie, trie->root, string, strlen(string), handler, data);
+}
+
+static int pattern_next_token(const char *pattern, int length, int pos, PatternToken *token)
+{
+	int end;
+
+	token->text = pattern + pos;
+	token->symbol = pattern[pos];
+
+	switch (pattern[pos])
+	{
+		case '*':
+			token->type = EG_PATTERN_STAR;
+			end = pos + 1;
+
+			while (end < length && pattern[end] == '*') {
+				end++;
+			}
+			break;
+
+		case '?':
+			token->type = EG_PATTERN_ANY;
+			end = pos + 1;
+			break;
+
+		case '[':
+			token->type = EG_PATTERN_CLASS;
+			end = pos + 1;
+
+			if (end < length && pattern[end] == '^') {
+				end++;
+			}
+
+			while (end < length)
+			{
+				if (pattern[end] == '\\') {
+					end += 2;
+				} else if (pattern[end] == ']') {
+					end++;
+					break;
+				} else if (end + 2 < length && pattern[end + 1] == '-') {
+					end += 3;
+				} else {
+					end++;
+				}
+			}
+
+			if (end > length) {
+				end = length;
+			}
+			break;
+
+		case '\\':
+			token->type = EG_PATTERN_LITERAL;
+
+			if (pos + 1 < length) {
+				token->symbol = pattern[pos + 1];
+				end = pos + 2;
+			} else {
+				end = pos + 1;
+			}
+			break;
+
+		default:
+			token->type = EG_PATTERN_LITERAL;
+			end = pos + 1;
+			break;
+	}
+
+	token->length = end - pos;
+
+	return end;
+}
+
+static PatternNode *pattern_create_node(PatternToken *token, PatternNode *parent)
+{
+	PatternNode *node = (PatternNode*)xmalloc(sizeof(*node));
+
+	node->type = token->type;
+	node->symbol = token->symbol;
+	node->token = NULL;
+	node->length = 0;
+	node->values = NULL;
+	node->patterns = 0;
+	node->stamp = 0;
+	node->parent = parent;
+	node->literals = NULL;
+	node->nliterals = 0;
+	node->wildcards = NULL;
+	node->next = NULL;
+
+	if (token->type == EG_PATTERN_CLASS)
+	{
+		node->token = (char*)xmalloc(token->length + 1);
+		memcpy(node->token, token->text, token->length);
+		node->token[token->length] = '\0';
+		node->length = token->length;
+	}
+
+	return node;
+}
+
+static void pattern_free_node(PatternNode *node)
+{
+	PatternNode *child, *next;
+	unsigned int i;
+
+	for (i = 0; i < node->nliterals; i++) {
+		pattern_free_node(node->literals[i]);
+	}
+
+	for (child = node->wildcards; child; child = next) {
+		next = child->next;
+		pattern_free_node(child);
+	}
+
+	if (node->literals) {
+		xfree(node->literals);
+	}
+
+	if (node->values) {
+		list_release(node->values);
+	}
+
+	if (node->token) {
+		xfree(node->token);
+	}
+
+	xfree(node);
+}
+
+static PatternNode *pattern_find_literal(PatternNode *node, unsigned char symbol, unsigned int *pos)
+{
+	unsigned int low = 0, high = node->nliterals, middle;
+
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+
+		if (node->literals[middle]->symbol < symbol) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if (pos) {
+		*pos = low;
+	}
+
+	if (low < node->nliterals && node->literals[low]->symbol == symbol) {
+		return node->literals[low];
+	}
+
+	return NULL;
+}
+
+static PatternNode *pattern_find_child(PatternNode *node, PatternToken *token)
+{
+	PatternNode *child;
+
+	if (token->type == EG_PATTERN_LITERAL) {
+		return pattern_find_literal(node, token->symbol, NULL);
+	}
+
+	for (child = node->wildcards; child; child = child->next)
+	{
+		if (child->type != token->type) {
+			continue;
+		}
+
+		if (child->type != EG_PATTERN_CLASS || (child->length == token->length &&
+			!memcmp(child->token, token->text, token->length))) {
+			return child;
+		}
+	}
+
+	return NULL;
+}
+
+static PatternNode *pattern_add_child(PatternNode *node, PatternToken *token)
+{
+	PatternNode *child;
+	unsigned int pos;
+
+	child = pattern_find_child(node, token);
+	if (child) {
+		return child;
+	}
+
+	child = pattern_create_node(token, node);
+
+	if (token->type == EG_PATTERN_LITERAL)
+	{
+		pattern_find_literal(node, token->symbol, &pos);
+
+		node->literals = (PatternNode**)xrealloc(node->literals,
+			sizeof(PatternNode*) * (node->nliterals + 1));
+
+		memmove(node->literals + pos + 1, node->literals + pos,
+			sizeof(PatternNode*) * (node->nliterals - pos));
+
+		node->literals[pos] = child;
+		node->nliterals++;
+	}
+	else
+	{
+		child->next = node->wildcards;
+		node->wildcards = child;
+	}
+
+	return child;
+}
+
+static void pattern_remove_child(PatternNode *node, PatternNode *child)
+{
+	PatternNode **link;
+	unsigned int pos;
+
+	if (child->type == EG_PATTERN_LITERAL)
+	{
+		pattern_find_literal(node, child->symbol, &pos);
+
+		memmove(node->literals + pos, node->literals + pos + 1,
+			sizeof(PatternNode*) * (node->nliterals - pos - 1));
+
+		node->nliterals--;
+
+		if (node->nliterals == 0) {
+			xfree(node->literals);
+			node->literals = NULL;
+		}
+
+		return;
+	}
+
+	for (link = &node->wildcards; *link; link = &(*link)->next)
+	{
+		if (*link == child) {
+			*link = child->next;
+			return;
+		}
+	}
+}
+
+static PatternNode *pattern_find_node(PatternTrie *trie, const char *pattern)
+{
+	PatternToken token;
+	PatternNode *node = trie->root;
+	int length = strlen(pattern);
+	int pos = 0;
+
+	while (pos < length && node)
+	{
+		pos = pattern_next_token(pattern, length, pos, &token);
+		node = pattern_find_child(node, &token);
+	}
+
+	return (node && node->values) ? node : NULL;
+}
+
+static int pattern_match_class(PatternNode *node, unsigned char symbol)
+{
+	const char *token = node->token;
+	int length = node->length;
+	int pos = 1, not = 0, match = 0;
+	unsigned char start, end, swap;
+
+	if (pos < length && token[pos] == '^') {
+		not = 1;
+		pos++;
+	}
+
+	while (pos < length)
+	{
+		if (token[pos] == '\\')
+		{
+			if (pos + 1 < length && (unsigned char)token[pos + 1] == symbol) {
+				match = 1;
+			}
+
+			pos += 2;
+		}
+		else if (token[pos] == ']')
+		{
+			break;
+		}
+		else if (pos + 2 < length && token[pos + 1] == '-')
+		{
+			start = token[pos];
+			end = token[pos + 2];
+
+			if (start > end) {
+				swap = start;
+				start = end;
+				end = swap;
+			}
+
+			if (symbol >= start && symbol <= end) {
+				match = 1;
+			}
+
+			pos += 3;
+		}
+		else
+		{
+			if ((unsigned char)token[pos] == symbol) {
+				match = 1;
+			}
+
+			pos++;
+		}
+	}
+
+	return not ? !match : match;
+}
+
+static void pattern_match_node(PatternTrie *trie, PatternNode *node, const char *string, int length,
+	pattern_handler *handler, void *data)
+{
+	PatternNode *child;
+	ListIterator iterator;
+	ListNode *value;
+	int i;
+
+	if (length == 0 && node->values && node->stamp != trie->stamp)
+	{
+		node->stamp = trie->stamp;
+
+		list_rewind(node->values, &iterator);
+		while ((value = list_next_node(&iterator)) != NULL) {
+			handler(EG_LIST_NODE_VALUE(value), data);
+		}
+	}
+
+	if (length && node->nliterals)
+	{
+		child = pattern_find_literal(node, string[0], NULL);
+		if (child) {
+			pattern_match_node(trie, child, string + 1, length - 1, handler, data);
+		}
+	}
+
+	for (child = node->wildcards; child; child = child->next)
+	{
+		switch (child->type)
+		{
+			case EG_PATTERN_STAR:
+				for (i = 0; i <= length; i++) {
+					pattern_match_node(trie, child, string + i, length - i, handler, data);
+				}
+				break;
+
+			case EG_PATTERN_ANY:
+				if (length) {
+					pattern_match_node(trie, child, string + 1, length - 1, handler, data);
+				}
+				break;
+
+			case EG_PATTERN_CLASS:
+				if (length && pattern_match_class(child, string[0])) {
+					pattern_match_node(trie, child, string + 1, length - 1, handler, data);
+				}
+				break;
+		}
+	}
+}
@@ -0,0 +1,69 @@
+/*
+   Copyright (c) 2012, Stanislav Yakush(st.yakush@yandex.ru)
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the EagleMQ nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __PATTERN_LIB_H__
+#define __PATTERN_LIB_H__
+
+#include "list.h"
+
+#define EG_PATTERN_LITERAL 0
+#define EG_PATTERN_ANY 1
+#define EG_PATTERN_STAR 2
+#define EG_PATTERN_CLASS 3
+
+#define EG_PATTERN_LENGTH(t) ((t)->len)
+
+typedef void pattern_handler(void *value, void *data);
+
+typedef struct PatternNode {
+	int type;
+	unsigned char symbol;
+	char *token;
+	int length;
+	List *values;
+	unsigned int patterns;
+	unsigned long stamp;
+	struct PatternNode *parent;
+	struct PatternNode **literals;
+	unsigned int nliterals;
+	struct PatternNode *wildcards;
+	struct PatternNode *next;
+} PatternNode;
+
+typedef struct PatternTrie {
+	PatternNode *root;
+	unsigned long stamp;
+	unsigned int len;
+} PatternTrie;
+
+PatternTrie *pattern_trie_create(void);
+void pattern_trie_release(PatternTrie *trie);
+int pattern_trie_insert(PatternTrie *trie, const char *pattern, void *value);
+int pattern_trie_delete(PatternTrie *trie, const char *pattern, void *value);
+void pattern_trie_match(PatternTrie *trie, const char *string, pattern_handler *handler, void *data);
+
+#endif
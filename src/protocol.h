@@ -109,7 +109,12 @@ typedef enum ProtocolCommand {
 	EG_PROTOCOL_CMD_CHANNEL_PSUBSCRIBE = 0x40,
 	EG_PROTOCOL_CMD_CHANNEL_UNSUBSCRIBE = 0x41,
 	EG_PROTOCOL_CMD_CHANNEL_PUNSUBSCRIBE = 0x42,
-	EG_PROTOCOL_CMD_CHANNEL_DELETE = 0x43
+	EG_PROTOCOL_CMD_CHANNEL_DELETE = 0x43,
+
+	/* queue batch commands (68..70) */
+	EG_PROTOCOL_CMD_QUEUE_PUSH_BATCH = 0x44,
+	EG_PROTOCOL_CMD_QUEUE_GET_BATCH = 0x45,
+	EG_PROTOCOL_CMD_QUEUE_POP_BATCH = 0x46
 } ProtocolCommand;
 
 typedef enum ProtocolResponseStatus {
@@ -307,6 +312,23 @@ typedef struct ProtocolRequestQueueDelete {
 	} body;
 } ProtocolRequestQueueDelete;
 
+typedef struct ProtocolRequestQueueGetBatch {
+	ProtocolRequestHeader header;
+	struct {
+		char name[64];
+		uint32_t count;
+	} body;
+} ProtocolRequestQueueGetBatch;
+
+typedef struct ProtocolRequestQueuePopBatch {
+	ProtocolRequestHeader header;
+	struct {
+		char name[64];
+		uint32_t timeout;
+		uint32_t count;
+	} body;
+} ProtocolRequestQueuePopBatch;
+
 typedef struct ProtocolRequestRouteCreate {
 	ProtocolRequestHeader header;
 	struct {
@@ -463,8 +485,13 @@ typedef struct ProtocolResponseStat {
 		uint32_t queues;
 		uint32_t routes;
 		uint32_t channels;
-		uint32_t resv3;
+		uint32_t client_memory;
 		uint32_t resv4;
+		uint64_t read_calls;
+		uint64_t write_calls;
+		uint64_t poll_calls;
+		uint64_t ctl_calls;
+		uint64_t fork_time;
 	} body;
 } ProtocolResponseStat;
 
@@ -482,6 +509,13 @@ typedef struct ProtocolResponseQueueSize {
 	} body;
 } ProtocolResponseQueueSize;
 
+typedef struct ProtocolResponseQueuePushBatch {
+	ProtocolResponseHeader header;
+	struct {
+		uint32_t pushed;
+	} body;
+} ProtocolResponseQueuePushBatch;
+
 typedef struct ProtocolResponseRouteExist {
 	ProtocolResponseHeader header;
 	struct {
@@ -30,59 +30,45 @@
 #include "queue.h"
 #include "xmalloc.h"
 
+#define EG_QUEUE_VALUE(q, p) ((q)->values[(p) & (q)->mask])
+
+static void queue_resize(Queue *queue, unsigned long size);
+static void queue_trim(Queue *queue);
+static void queue_compact(Queue *queue);
+
 Queue *queue_create(void)
 {
 	Queue *queue;
 
 	queue = (Queue*)xmalloc(sizeof(*queue));
 
-	queue->head = queue->tail = NULL;
+	queue->values = NULL;
+	queue->size = 0;
+	queue->mask = 0;
+	queue->head = queue->tail = 0;
 	queue->len = 0;
 	queue->free = NULL;
+	queue->index = NULL;
 
 	return queue;
 }
 
 void queue_release(Queue *queue)
 {
-	unsigned int len;
-	QueueNode *current, *next;
-
-	current = queue->head;
-	len = queue->len;
-
-	while (len--) {
-		next = current->next;
-
-		if (queue->free) {
-			queue->free(current->value);
-		}
-
-		xfree(current);
-		current = next;
-	}
+	queue_purge(queue);
 
-    xfree(queue);
+	xfree(queue);
 }
 
 Queue *queue_push_value_head(Queue *queue, void *value)
 {
-	QueueNode *node;
-
-	node = (QueueNode*)xmalloc(sizeof(*node));
-
-	node->value = value;
-
-	if (queue->len == 0) {
-		queue->head = queue->tail = node;
-		node->prev = node->next = NULL;
-	} else {
-		node->prev = NULL;
-		node->next = queue->head;
-		queue->head->prev = node;
-		queue->head = node;
+	if (queue->head - queue->tail == queue->size) {
+		queue_resize(queue, queue->size ? queue->size * 2 : EG_QUEUE_MIN_SIZE);
 	}
 
+	EG_QUEUE_VALUE(queue, queue->head) = value;
+	queue->head++;
+
 	queue->len++;
 
 	return queue;
@@ -90,22 +76,13 @@ Queue *queue_push_value_head(Queue *queue, void *value)
 
 Queue *queue_push_value_tail(Queue *queue, void *value)
 {
-	QueueNode *node;
-
-	node = (QueueNode*)xmalloc(sizeof(*node));
-
-	node->value = value;
-
-	if (queue->len == 0) {
-		queue->head = queue->tail = node;
-		node->prev = node->next = NULL;
-	} else {
-		node->prev = queue->tail;
-		node->next = NULL;
-		queue->tail->next = node;
-		queue->tail = node;
+	if (queue->head - queue->tail == queue->size) {
+		queue_resize(queue, queue->size ? queue->size * 2 : EG_QUEUE_MIN_SIZE);
 	}
 
+	queue->tail--;
+	EG_QUEUE_VALUE(queue, queue->tail) = value;
+
 	queue->len++;
 
 	return queue;
@@ -113,81 +90,79 @@ Queue *queue_push_value_tail(Queue *queue, void *value)
 
 void *queue_get_value(Queue *queue)
 {
-	void *value;
-
 	if (!queue->len) {
 		return NULL;
 	}
 
-	value = EG_QUEUE_NODE_VALUE(queue->tail);
-
-	return value;
+	return EG_QUEUE_VALUE(queue, queue->tail);
 }
 
 void *queue_pop_value(Queue *queue)
 {
-	QueueNode *prev;
 	void *value;
 
 	if (!queue->len) {
 		return NULL;
 	}
 
-	value = EG_QUEUE_NODE_VALUE(queue->tail);
-	prev = queue->tail->prev;
+	value = EG_QUEUE_VALUE(queue, queue->tail);
+	EG_QUEUE_VALUE(queue, queue->tail) = NULL;
 
-	xfree(queue->tail);
-
-	queue->tail = prev;
+	queue->tail++;
 	queue->len--;
 
+	queue_trim(queue);
+
 	return value;
 }
 
 Queue *queue_purge(Queue *queue)
 {
-	unsigned int len;
-	QueueNode *current, *next;
-
-	current = queue->head;
-	len = queue->len;
+	uint64_t position;
+	void *value;
 
-	while (len--) {
-		next = current->next;
+	for (position = queue->tail; position != queue->head; position++)
+	{
+		value = EG_QUEUE_VALUE(queue, position);
 
-		if (queue->free) {
-			queue->free(current->value);
+		if (value && queue->free) {
+			queue->free(value);
 		}
+	}
 
-		xfree(current);
-		current = next;
+	if (queue->values) {
+		xfree(queue->values);
 	}
 
+	queue->values = NULL;
+	queue->size = 0;
+	queue->mask = 0;
+	queue->head = queue->tail = 0;
 	queue->len = 0;
 
 	return queue;
 }
 
-void queue_delete_node(Queue *queue, QueueNode *node)
+void queue_delete_position(Queue *queue, uint64_t position)
 {
-	if (node->prev) {
-		node->prev->next = node->next;
-	} else {
-		queue->head = node->next;
-	}
+	void *value = EG_QUEUE_VALUE(queue, position);
 
-	if (node->next) {
-		node->next->prev = node->prev;
-	} else {
-		queue->tail = node->prev;
+	if (!value) {
+		return;
 	}
 
+	EG_QUEUE_VALUE(queue, position) = NULL;
+	queue->len--;
+
 	if (queue->free) {
-		queue->free(node->value);
+		queue->free(value);
 	}
 
-	xfree(node);
-	queue->len--;
+	queue_trim(queue);
+
+	if (queue->head - queue->tail > EG_QUEUE_MIN_SIZE && queue->head - queue->tail > (uint64_t)queue->len * 2) {
+		queue_compact(queue);
+	}
 }
 
 QueueIterator *queue_get_iterator(Queue *queue, int direction)
@@ -196,6 +171,8 @@ QueueIterator *queue_get_iterator(Queue *queue, int direction)
 
 	iter = (QueueIterator*)xmalloc(sizeof(*iter));
 
+	iter->queue = queue;
+
 	if (direction == EG_START_HEAD) {
 		iter->next = queue->head;
 	} else {
@@ -212,23 +189,110 @@ void queue_release_iterator(QueueIterator *iter)
 	xfree(iter);
 }
 
-QueueNode *queue_next_node(QueueIterator *iter)
+void *queue_next_value(QueueIterator *iter)
 {
-	QueueNode *current = iter->next;
+	Queue *queue = iter->queue;
+	void *value = NULL;
 
-	if (current != NULL) {
+	while (!value)
+	{
 		if (iter->direction == EG_START_HEAD) {
-			iter->next = current->next;
+			if (iter->next == queue->tail) {
+				return NULL;
+			}
+
+			iter->next--;
+			value = EG_QUEUE_VALUE(queue, iter->next);
 		} else {
-			iter->next = current->prev;
+			if (iter->next == queue->head) {
+				return NULL;
+			}
+
+			value = EG_QUEUE_VALUE(queue, iter->next);
+			iter->next++;
 		}
 	}
 
-	return current;
+	return value;
 }
 
 void queue_rewind(Queue *queue, QueueIterator *iter)
 {
+	iter->queue = queue;
 	iter->next = queue->head;
 	iter->direction = EG_START_HEAD;
 }
+
+void queue_rewind_tail(Queue *queue, QueueIterator *iter)
+{
+	iter->queue = queue;
+	iter->next = queue->tail;
+	iter->direction = EG_START_TAIL;
+}
+
+static void queue_resize(Queue *queue, unsigned long size)
+{
+	void **values;
+	unsigned long mask = size - 1;
+	uint64_t position;
+
+	values = (void**)xmalloc(sizeof(void*) * size);
+
+	for (position = queue->tail; position != queue->head; position++) {
+		values[position & mask] = EG_QUEUE_VALUE(queue, position);
+	}
+
+	if (queue->values) {
+		xfree(queue->values);
+	}
+
+	queue->values = values;
+	queue->size = size;
+	queue->mask = mask;
+}
+
+static void queue_trim(Queue *queue)
+{
+	while (queue->tail != queue->head && !EG_QUEUE_VALUE(queue, queue->tail)) {
+		queue->tail++;
+	}
+
+	while (queue->head != queue->tail && !EG_QUEUE_VALUE(queue, queue->head - 1)) {
+		queue->head--;
+	}
+
+	if (queue->size > EG_QUEUE_MIN_SIZE && (queue->head - queue->tail) * 4 < queue->size) {
+		queue_resize(queue, queue->size / 2);
+	}
+}
+
+static void queue_compact(Queue *queue)
+{
+	uint64_t position, target;
+	void *value;
+
+	for (position = target = queue->tail; position != queue->head; position++)
+	{
+		value = EG_QUEUE_VALUE(queue, position);
+
+		if (!value) {
+			continue;
+		}
+
+		if (position != target)
+		{
+			EG_QUEUE_VALUE(queue, target) = value;
+			EG_QUEUE_VALUE(queue, position) = NULL;
+
+			if (queue->index) {
+				queue->index(value, target);
+			}
+		}
+
+		target++;
+	}
+
+	queue->head = target;
+
+	queue_trim(queue);
+}
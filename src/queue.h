@@ -28,34 +28,37 @@
 #ifndef __QUEUE_LIB_H__
 #define __QUEUE_LIB_H__
 
+#include <stdint.h>
+
 #define EG_START_HEAD 0
 #define EG_START_TAIL 1
 
+#define EG_QUEUE_MIN_SIZE 16
+
 #define EG_QUEUE_LENGTH(q) ((q)->len)
-#define EG_QUEUE_FIRST(q) ((q)->head)
+#define EG_QUEUE_FIRST(q) ((q)->head - 1)
 #define EG_QUEUE_LAST(q) ((q)->tail)
-#define EG_QUEUE_PREV_NODE(n) ((n)->prev)
-#define EG_QUEUE_NEXT_NODE(n) ((n)->next)
-#define EG_QUEUE_NODE_VALUE(n) ((n)->value)
 
 #define EG_QUEUE_SET_FREE_METHOD(q, m) ((q)->free = (m))
 #define EG_QUEUE_GET_FREE_METHOD(q) ((q)->free)
 
-typedef struct QueueNode {
-	struct QueueNode *prev;
-	struct QueueNode *next;
-	void *value;
-} QueueNode;
+#define EG_QUEUE_SET_INDEX_METHOD(q, m) ((q)->index = (m))
+#define EG_QUEUE_GET_INDEX_METHOD(q) ((q)->index)
 
 typedef struct QueueIterator {
-	QueueNode *next;
+	struct Queue *queue;
+	uint64_t next;
 	int direction;
 } QueueIterator;
 
 typedef struct Queue {
-	QueueNode *head;
-	QueueNode *tail;
+	void **values;
+	unsigned long size;
+	unsigned long mask;
+	uint64_t head;
+	uint64_t tail;
 	void (*free)(void *ptr);
+	void (*index)(void *value, uint64_t position);
 	unsigned int len;
 } Queue;
 
@@ -66,10 +69,11 @@ Queue *queue_push_value_tail(Queue *queue, void *value);
 void *queue_get_value(Queue *queue);
 void *queue_pop_value(Queue *queue);
 Queue *queue_purge(Queue *queue);
-void queue_delete_node(Queue *queue, QueueNode *node);
+void queue_delete_position(Queue *queue, uint64_t position);
 QueueIterator *queue_get_iterator(Queue *queue, int direction);
 void queue_release_iterator(QueueIterator *iter);
-QueueNode *queue_next_node(QueueIterator *iter);
+void *queue_next_value(QueueIterator *iter);
 void queue_rewind(Queue *queue, QueueIterator *iter);
+void queue_rewind_tail(Queue *queue, QueueIterator *iter);
 
 #endif
@@ -37,9 +37,13 @@
 #include "object.h"
 #include "message.h"
 #include "handlers.h"
+#include "aof.h"
+#include "storage.h"
 #include "queue.h"
 #include "list.h"
 #include "keylist.h"
+#include "dict.h"
+#include "heap.h"
 #include "xmalloc.h"
 #include "utils.h"
 
@@ -49,6 +53,8 @@ static void eject_routes_queue_t(Queue_t *queue_t);
 
 static void free_route_keylist_handler(void *key, void *value);
 static int match_route_keylist_handler(void *key1, void *key2);
+static void index_message_heap_handler(void *value, unsigned long index);
+static void index_message_queue_handler(void *value, uint64_t position);
 
 Queue_t *create_queue_t(const char *name, uint32_t max_msg, uint32_t max_msg_size, uint32_t flags)
 {
@@ -77,14 +83,23 @@ Queue_t *create_queue_t(const char *name, uint32_t max_msg, uint32_t max_msg_siz
 	}
 
 	queue_t->queue = queue_create();
-	queue_t->expire_messages = list_create();
-	queue_t->confirm_messages = list_create();
+	queue_t->expire_messages = heap_create();
+	queue_t->confirm_messages = heap_create();
+	queue_t->confirm_index = dict_create();
+	queue_t->timer = EG_HEAP_NO_INDEX;
 	queue_t->declared_clients = list_create();
 	queue_t->subscribed_clients_msg = list_create();
 	queue_t->subscribed_clients_notify = list_create();
 	queue_t->routes = keylist_create();
+	queue_t->snapshot = NULL;
 
 	EG_QUEUE_SET_FREE_METHOD(queue_t->queue, free_message_list_handler);
+	EG_QUEUE_SET_INDEX_METHOD(queue_t->queue, index_message_queue_handler);
+	EG_HEAP_SET_INDEX_METHOD(queue_t->expire_messages, index_message_heap_handler);
+	EG_HEAP_SET_INDEX_METHOD(queue_t->confirm_messages, index_message_heap_handler);
+	EG_DICT_SET_HASH_METHOD(queue_t->confirm_index, dict_uint64_hash);
+	EG_DICT_SET_MATCH_METHOD(queue_t->confirm_index, dict_uint64_match);
+	EG_KEYLIST_SET_HASH_METHOD(queue_t->routes, dict_string_hash);
 	EG_KEYLIST_SET_FREE_METHOD(queue_t->routes, free_route_keylist_handler);
 	EG_KEYLIST_SET_MATCH_METHOD(queue_t->routes, match_route_keylist_handler);
 
@@ -93,11 +108,20 @@ Queue_t *create_queue_t(const char *name, uint32_t max_msg, uint32_t max_msg_siz
 
 void delete_queue_t(Queue_t *queue_t)
 {
+	storage_freeze_queue(queue_t);
+
 	eject_clients_queue_t(queue_t);
 	eject_routes_queue_t(queue_t);
 
-	list_release(queue_t->expire_messages);
-	list_release(queue_t->confirm_messages);
+	if (queue_t->timer != EG_HEAP_NO_INDEX) {
+		heap_delete(server->queue_timers, queue_t->timer);
+	}
+
+	EG_HEAP_SET_FREE_METHOD(queue_t->confirm_messages, free_message_list_handler);
+
+	heap_release(queue_t->expire_messages);
+	heap_release(queue_t->confirm_messages);
+	dict_release(queue_t->confirm_index);
 	list_release(queue_t->declared_clients);
 	list_release(queue_t->subscribed_clients_msg);
 	list_release(queue_t->subscribed_clients_notify);
@@ -153,17 +177,32 @@ static int process_subscribed_clients(Queue_t *queue_t, Message *msg)
 	return processed;
 }
 
+static void store_message_queue_t(Queue_t *queue_t, Message *msg)
+{
+	queue_push_value_head(queue_t->queue, msg);
+
+	if (msg->expiration)
+	{
+		EG_MESSAGE_SET_POSITION(msg, EG_QUEUE_FIRST(queue_t->queue));
+		heap_push(queue_t->expire_messages, EG_MESSAGE_GET_EXPIRATION_TIME(msg), msg);
+		schedule_queue_t(queue_t);
+	}
+}
+
 int push_message_queue_t(Queue_t *queue_t, Object *data, uint32_t expiration)
 {
 	Message *msg;
-	uint64_t tag = make_message_tag(server->msg_counter++, server->now_timems);
-
-	msg = create_message(data, tag, expiration);
+	uint64_t tag;
 
-	if (EG_MESSAGE_SIZE(msg) > queue_t->max_msg_size) {
+	if (EG_OBJECT_SIZE(data) > queue_t->max_msg_size) {
 		return EG_STATUS_ERR;
 	}
 
+	tag = make_message_tag(server->msg_counter++, server->now_timems);
+
+	msg = create_message(data, tag, expiration);
+	increment_references_count(data);
+
 	if (process_subscribed_clients(queue_t, msg)) {
 		release_message(msg);
 		return EG_STATUS_OK;
@@ -174,86 +213,162 @@ int push_message_queue_t(Queue_t *queue_t, Object *data, uint32_t expiration)
 		if (queue_t->force_push) {
 			pop_message_queue_t(queue_t, 0);
 		} else {
+			release_message(msg);
 			return EG_STATUS_ERR;
 		}
 	}
 
-	queue_push_value_head(queue_t->queue, msg);
+	store_message_queue_t(queue_t, msg);
 
-	if (msg->expiration)
-	{
-		list_add_value_tail(queue_t->expire_messages, msg);
-		EG_MESSAGE_SET_DATA(msg, 0, EG_LIST_LAST(queue_t->expire_messages));
-		EG_MESSAGE_SET_DATA(msg, 1, EG_QUEUE_FIRST(queue_t->queue));
-	}
+	aof_log_message_push(queue_t, msg);
 
 	return EG_STATUS_OK;
 }
 
+void restore_message_queue_t(Queue_t *queue_t, Object *data, uint64_t tag, uint32_t expiration)
+{
+	Message *msg = create_message(data, tag, expiration);
+
+	increment_references_count(data);
+
+	store_message_queue_t(queue_t, msg);
+}
+
+void restore_unconfirmed_message_queue_t(Queue_t *queue_t, Object *data,
+	uint64_t tag, uint32_t expiration, uint32_t confirm)
+{
+	Message *msg = create_message(data, tag, expiration);
+
+	increment_references_count(data);
+
+	EG_MESSAGE_SET_CONFIRM_TIME(msg, confirm);
+	heap_push(queue_t->confirm_messages, EG_MESSAGE_GET_CONFIRM_TIME(msg), msg);
+	dict_add(queue_t->confirm_index, &msg->tag, msg);
+
+	schedule_queue_t(queue_t);
+}
+
 Message *get_message_queue_t(Queue_t *queue_t)
 {
 	return queue_get_value(queue_t->queue);
 }
 
+void rewind_messages_queue_t(Queue_t *queue_t, QueueIterator *iterator)
+{
+	queue_rewind_tail(queue_t->queue, iterator);
+}
+
 void pop_message_queue_t(Queue_t *queue_t, uint32_t timeout)
 {
-	Message *msg = queue_pop_value(queue_t->queue);
+	Message *msg;
+
+	storage_freeze_tail_message(queue_t);
+
+	msg = queue_pop_value(queue_t->queue);
+
+	aof_log_message_pop(queue_t, msg, timeout);
 
 	if (msg->expiration) {
-		list_delete_node(queue_t->expire_messages, EG_MESSAGE_GET_DATA(msg, 0));
+		heap_delete(queue_t->expire_messages, EG_MESSAGE_GET_TIMER(msg));
 	}
 
 	if (timeout) {
 		EG_MESSAGE_SET_CONFIRM_TIME(msg, server->now_timems + timeout);
-		list_add_value_tail(queue_t->confirm_messages, msg);
+		heap_push(queue_t->confirm_messages, EG_MESSAGE_GET_CONFIRM_TIME(msg), msg);
+		dict_add(queue_t->confirm_index, &msg->tag, msg);
 	} else {
 		release_message(msg);
 	}
+
+	schedule_queue_t(queue_t);
 }
 
 int confirm_message_queue_t(Queue_t *queue_t, uint64_t tag)
 {
-	ListNode *node;
-	ListIterator iterator;
 	Message *msg;
 
-	list_rewind(queue_t->confirm_messages, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
-	{
-		msg = EG_LIST_NODE_VALUE(node);
+	msg = dict_fetch_value(queue_t->confirm_index, &tag);
+	if (!msg) {
+		return EG_STATUS_ERR;
+	}
 
-		if (EG_MESSAGE_GET_TAG(msg) == tag)
-		{
-			list_delete_node(queue_t->confirm_messages, node);
-			release_message(msg);
-			return EG_STATUS_OK;
-		}
+	aof_log_message_confirm(queue_t, tag);
+
+	dict_delete(queue_t->confirm_index, &msg->tag);
+	heap_delete(queue_t->confirm_messages, EG_MESSAGE_GET_TIMER(msg));
+	release_message(msg);
+
+	schedule_queue_t(queue_t);
+
+	return EG_STATUS_OK;
+}
+
+void register_queue_t(Queue_t *queue_t)
+{
+	list_add_value_tail(server->queues, queue_t);
+	dict_add(server->queue_index, queue_t->name, EG_LIST_LAST(server->queues));
+
+	aof_log_queue_create(queue_t);
+}
+
+int unregister_queue_t(Queue_t *queue_t)
+{
+	ListNode *node = dict_fetch_value(server->queue_index, queue_t->name);
+
+	if (!node || EG_LIST_NODE_VALUE(node) != queue_t) {
+		return EG_STATUS_ERR;
 	}
 
-	return EG_STATUS_ERR;
+	aof_log_queue_delete(queue_t);
+
+	dict_delete(server->queue_index, queue_t->name);
+	list_delete_node(server->queues, node);
+
+	return EG_STATUS_OK;
 }
 
-Queue_t *find_queue_t(List *list, const char *name)
+Queue_t *find_queue_t(const char *name)
 {
-	Queue_t *queue_t;
-	ListNode *node;
-	ListIterator iterator;
+	ListNode *node = dict_fetch_value(server->queue_index, (void*)name);
 
-	list_rewind(list, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
-	{
-		queue_t = EG_LIST_NODE_VALUE(node);
-		if (!strcmp(queue_t->name, name)) {
-			return queue_t;
-		}
+	return node ? EG_LIST_NODE_VALUE(node) : NULL;
+}
+
+Queue_t *find_declared_queue_t(EagleClient *client, const char *name)
+{
+	Queue_t *queue_t = find_queue_t(name);
+
+	if (!queue_t || !dict_find(client->declared_queues, queue_t)) {
+		return NULL;
+	}
+
+	return queue_t;
+}
+
+Queue_t *find_subscribed_queue_t(EagleClient *client, const char *name)
+{
+	Queue_t *queue_t = find_queue_t(name);
+
+	if (!queue_t || !dict_find(client->subscribed_queues, queue_t)) {
+		return NULL;
 	}
 
-	return NULL;
+	return queue_t;
 }
 
 void rename_queue_t(Queue_t *queue_t, const char *name)
 {
+	ListNode *node = dict_fetch_value(server->queue_index, queue_t->name);
+
+	aof_log_queue_rename(queue_t, name);
+
+	dict_delete(server->queue_index, queue_t->name);
+
 	memcpy(queue_t->name, name, strlenz(name));
+
+	if (node) {
+		dict_add(server->queue_index, queue_t->name, node);
+	}
 }
 
 uint32_t get_declared_clients_queue_t(Queue_t *queue_t)
@@ -274,24 +389,30 @@ uint32_t get_size_queue_t(Queue_t *queue_t)
 
 void purge_queue_t(Queue_t *queue_t)
 {
+	aof_log_queue_purge(queue_t);
+	storage_freeze_queue(queue_t);
+
+	heap_empty(queue_t->expire_messages);
 	queue_purge(queue_t->queue);
+
+	schedule_queue_t(queue_t);
 }
 
 void declare_client_queue_t(Queue_t *queue_t, EagleClient *client)
 {
-	list_add_value_tail(client->declared_queues, queue_t);
+	dict_add(client->declared_queues, queue_t, queue_t);
 	list_add_value_tail(queue_t->declared_clients, client);
 }
 
 void undeclare_client_queue_t(Queue_t *queue_t, EagleClient *client)
 {
-	list_delete_value(client->declared_queues, queue_t);
+	dict_delete(client->declared_queues, queue_t);
 	list_delete_value(queue_t->declared_clients, client);
 }
 
 void subscribe_client_queue_t(Queue_t *queue_t, EagleClient *client, uint32_t flags)
 {
-	list_add_value_tail(client->subscribed_queues, queue_t);
+	dict_add(client->subscribed_queues, queue_t, queue_t);
 
 	if (!BIT_CHECK(flags, EG_QUEUE_CLIENT_NOTIFY_FLAG)) {
 		list_add_value_tail(queue_t->subscribed_clients_msg, client);
@@ -305,7 +426,7 @@ void unsubscribe_client_queue_t(Queue_t *queue_t, EagleClient *client)
 	ListNode *node;
 	ListIterator iterator;
 
-	list_delete_value(client->subscribed_queues, queue_t);
+	dict_delete(client->subscribed_queues, queue_t);
 
 	list_rewind(queue_t->subscribed_clients_msg, &iterator);
 	while ((node = list_next_node(&iterator)) != NULL)
@@ -366,62 +487,97 @@ void process_queue_t(Queue_t *queue_t)
 	if (queue_t->auto_delete)
 	{
 		if (EG_LIST_LENGTH(queue_t->declared_clients) == 0) {
-			list_delete_value(server->queues, queue_t);
+			unregister_queue_t(queue_t);
 		}
 	}
 }
 
 void process_expired_messages_queue_t(Queue_t *queue_t, uint32_t time)
 {
-	ListNode *node;
-	ListIterator iterator;
 	Message *msg;
 
-	list_rewind(queue_t->expire_messages, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
-	{
-		msg = EG_LIST_NODE_VALUE(node);
+	if (EG_HEAP_LENGTH(queue_t->expire_messages) &&
+		EG_HEAP_TOP_KEY(queue_t->expire_messages) <= time) {
+		aof_log_messages_expire(queue_t, time);
+		storage_freeze_queue(queue_t);
+	}
 
-		if (EG_MESSAGE_GET_EXPIRATION_TIME(msg) <= time) {
-			list_delete_node(queue_t->expire_messages, node);
-			queue_delete_node(queue_t->queue, EG_MESSAGE_GET_DATA(msg, 1));
-		}
+	while (EG_HEAP_LENGTH(queue_t->expire_messages) &&
+		EG_HEAP_TOP_KEY(queue_t->expire_messages) <= time)
+	{
+		msg = heap_pop(queue_t->expire_messages);
+		queue_delete_position(queue_t->queue, EG_MESSAGE_GET_POSITION(msg));
 	}
 }
 
 void process_unconfirmed_messages_queue_t(Queue_t *queue_t, uint32_t time)
 {
-	ListNode *node;
-	ListIterator iterator;
 	Message *msg;
 
-	list_rewind(queue_t->confirm_messages, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
+	if (EG_HEAP_LENGTH(queue_t->confirm_messages) &&
+		EG_HEAP_TOP_KEY(queue_t->confirm_messages) <= time) {
+		aof_log_messages_redeliver(queue_t, time);
+	}
+
+	while (EG_HEAP_LENGTH(queue_t->confirm_messages) &&
+		EG_HEAP_TOP_KEY(queue_t->confirm_messages) <= time)
 	{
-		msg = EG_LIST_NODE_VALUE(node);
+		msg = heap_pop(queue_t->confirm_messages);
+		dict_delete(queue_t->confirm_index, &msg->tag);
 
-		if (EG_MESSAGE_GET_CONFIRM_TIME(msg) <= time)
+		if (msg->expiration)
 		{
-			list_delete_node(queue_t->confirm_messages, node);
+			if (EG_MESSAGE_GET_EXPIRATION_TIME(msg) <= time) {
+				release_message(msg);
+				continue;
+			}
 
-			if (msg->expiration)
-			{
-				if (EG_MESSAGE_GET_EXPIRATION_TIME(msg) <= time) {
-					continue;
-				}
+			queue_push_value_tail(queue_t->queue, msg);
 
-				queue_push_value_tail(queue_t->queue, msg);
+			EG_MESSAGE_SET_POSITION(msg, EG_QUEUE_LAST(queue_t->queue));
+			heap_push(queue_t->expire_messages, EG_MESSAGE_GET_EXPIRATION_TIME(msg), msg);
+		}
+		else
+		{
+			queue_push_value_tail(queue_t->queue, msg);
+		}
+	}
+}
 
-				list_add_value_tail(queue_t->expire_messages, msg);
-				EG_MESSAGE_SET_DATA(msg, 0, EG_LIST_LAST(queue_t->expire_messages));
-				EG_MESSAGE_SET_DATA(msg, 1, EG_QUEUE_LAST(queue_t->queue));
-			}
-			else
-			{
-				queue_push_value_tail(queue_t->queue, msg);
-			}
+void schedule_queue_t(Queue_t *queue_t)
+{
+	uint64_t deadline = 0;
+	int scheduled = 0;
+
+	if (EG_HEAP_LENGTH(queue_t->expire_messages))
+	{
+		deadline = EG_HEAP_TOP_KEY(queue_t->expire_messages);
+		scheduled = 1;
+	}
+
+	if (EG_HEAP_LENGTH(queue_t->confirm_messages))
+	{
+		if (!scheduled || EG_HEAP_TOP_KEY(queue_t->confirm_messages) < deadline) {
+			deadline = EG_HEAP_TOP_KEY(queue_t->confirm_messages);
+		}
+
+		scheduled = 1;
+	}
+
+	if (!scheduled)
+	{
+		if (queue_t->timer != EG_HEAP_NO_INDEX) {
+			heap_delete(server->queue_timers, queue_t->timer);
 		}
 	}
+	else if (queue_t->timer == EG_HEAP_NO_INDEX)
+	{
+		heap_push(server->queue_timers, deadline, queue_t);
+	}
+	else
+	{
+		heap_update(server->queue_timers, queue_t->timer, deadline);
+	}
 }
 
 static void eject_clients_queue_t(Queue_t *queue_t)
@@ -440,7 +596,7 @@ static void eject_clients_queue_t(Queue_t *queue_t)
 	{
 		client = EG_LIST_NODE_VALUE(node);
 
-		list_delete_value(client->subscribed_queues, queue_t);
+		dict_delete(client->subscribed_queues, queue_t);
 		list_delete_node(queue_t->subscribed_clients_msg, node);
 	}
 
@@ -449,7 +605,7 @@ static void eject_clients_queue_t(Queue_t *queue_t)
 	{
 		client = EG_LIST_NODE_VALUE(node);
 
-		list_delete_value(client->subscribed_queues, queue_t);
+		dict_delete(client->subscribed_queues, queue_t);
 		list_delete_node(queue_t->subscribed_clients_notify, node);
 	}
 }
@@ -492,6 +648,23 @@ static void free_route_keylist_handler(void *key, void *value)
 	list_release(value);
 }
 
+void index_queue_heap_handler(void *value, unsigned long index)
+{
+	Queue_t *queue_t = value;
+
+	queue_t->timer = index;
+}
+
+static void index_message_heap_handler(void *value, unsigned long index)
+{
+	EG_MESSAGE_SET_TIMER((Message*)value, index);
+}
+
+static void index_message_queue_handler(void *value, uint64_t position)
+{
+	EG_MESSAGE_SET_POSITION((Message*)value, position);
+}
+
 static int match_route_keylist_handler(void *key1, void *key2)
 {
 	return !strcmp(key1, key2);
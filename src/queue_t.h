@@ -33,16 +33,25 @@
 #include "eagle.h"
 #include "list.h"
 #include "keylist.h"
+#include "heap.h"
 #include "object.h"
 #include "message.h"
 
 Queue_t *create_queue_t(const char *name, uint32_t max_msg, uint32_t max_msg_size, uint32_t flags);
 void delete_queue_t(Queue_t *queue_t);
 int push_message_queue_t(Queue_t *queue_t, Object *data, uint32_t expiration);
+void restore_message_queue_t(Queue_t *queue_t, Object *data, uint64_t tag, uint32_t expiration);
+void restore_unconfirmed_message_queue_t(Queue_t *queue_t, Object *data,
+	uint64_t tag, uint32_t expiration, uint32_t confirm);
 Message *get_message_queue_t(Queue_t *queue_t);
+void rewind_messages_queue_t(Queue_t *queue_t, QueueIterator *iterator);
 void pop_message_queue_t(Queue_t *queue_t, uint32_t timeout);
 int confirm_message_queue_t(Queue_t *queue_t, uint64_t tag);
-Queue_t *find_queue_t(List *list, const char *name);
+void register_queue_t(Queue_t *queue_t);
+int unregister_queue_t(Queue_t *queue_t);
+Queue_t *find_queue_t(const char *name);
+Queue_t *find_declared_queue_t(EagleClient *client, const char *name);
+Queue_t *find_subscribed_queue_t(EagleClient *client, const char *name);
 void rename_queue_t(Queue_t *queue_t, const char *name);
 uint32_t get_declared_clients_queue_t(Queue_t *queue_t);
 uint32_t get_subscribed_clients_queue_t(Queue_t *queue_t);
@@ -57,6 +66,8 @@ void unlink_queue_route_t(Queue_t *queue_t, Route_t *route, const char *key);
 void process_queue_t(Queue_t *queue_t);
 void process_expired_messages_queue_t(Queue_t *queue_t, uint32_t time);
 void process_unconfirmed_messages_queue_t(Queue_t *queue_t, uint32_t time);
+void schedule_queue_t(Queue_t *queue_t);
 void free_queue_list_handler(void *ptr);
+void index_queue_heap_handler(void *value, unsigned long index);
 
 #endif
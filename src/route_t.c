@@ -35,11 +35,14 @@
 #include "queue_t.h"
 #include "protocol.h"
 #include "keylist.h"
+#include "dict.h"
+#include "aof.h"
 #include "xmalloc.h"
 #include "utils.h"
 
 static void unbind_queues_key_route_t(Route_t *route, List *queues, const char *key);
 static void unbind_queues_route_t(Route_t* route);
+static int writable_queues_route_t(List *queues);
 
 static void free_route_keylist_handler(void *key, void *value);
 static int match_route_keylist_handler(void *key1, void *key2);
@@ -64,6 +67,7 @@ Route_t *create_route_t(const char *name, uint32_t flags)
 
 	route->keys = keylist_create();
 
+	EG_KEYLIST_SET_HASH_METHOD(route->keys, dict_string_hash);
 	EG_KEYLIST_SET_FREE_METHOD(route->keys, free_route_keylist_handler);
 	EG_KEYLIST_SET_MATCH_METHOD(route->keys, match_route_keylist_handler);
 
@@ -95,6 +99,10 @@ int push_message_route_t(Route_t *route, const char *key, Object *msg, uint32_t
 
 	list = EG_KEYLIST_NODE_VALUE(keylist_node);
 
+	if (server->aof_failed && !writable_queues_route_t(list)) {
+		return EG_STATUS_ERR;
+	}
+
 	if (route->round_robin)
 	{
 		list_rotate(list);
@@ -103,8 +111,6 @@ int push_message_route_t(Route_t *route, const char *key, Object *msg, uint32_t
 
 		if (push_message_queue_t(queue_t, msg, expiration) != EG_STATUS_OK)
 			status = EG_STATUS_ERR;
-
-		increment_references_count(msg);
 	}
 	else
 	{
@@ -115,8 +121,6 @@ int push_message_route_t(Route_t *route, const char *key, Object *msg, uint32_t
 
 			if (push_message_queue_t(queue_t, msg, expiration) != EG_STATUS_OK)
 				status = EG_STATUS_ERR;
-
-			increment_references_count(msg);
 		}
 	}
 
@@ -170,34 +174,51 @@ int unbind_route_t(Route_t *route, Queue_t *queue_t, const char *key)
 	if (route->auto_delete)
 	{
 		if (EG_KEYLIST_LENGTH(route->keys) == 0) {
-			list_delete_value(server->routes, route);
+			unregister_route_t(route);
 		}
 	}
 
 	return EG_STATUS_OK;
 }
 
-Route_t *find_route_t(List *list, const char *name)
+void register_route_t(Route_t *route)
 {
-	Route_t *route;
-	ListNode *node;
-	ListIterator iterator;
+	list_add_value_tail(server->routes, route);
+	dict_add(server->route_index, route->name, EG_LIST_LAST(server->routes));
+}
 
-	list_rewind(list, &iterator);
-	while ((node = list_next_node(&iterator)) != NULL)
-	{
-		route = EG_LIST_NODE_VALUE(node);
-		if (!strcmp(route->name, name)) {
-			return route;
-		}
+int unregister_route_t(Route_t *route)
+{
+	ListNode *node = dict_fetch_value(server->route_index, route->name);
+
+	if (!node || EG_LIST_NODE_VALUE(node) != route) {
+		return EG_STATUS_ERR;
 	}
 
-	return NULL;
+	dict_delete(server->route_index, route->name);
+	list_delete_node(server->routes, node);
+
+	return EG_STATUS_OK;
+}
+
+Route_t *find_route_t(const char *name)
+{
+	ListNode *node = dict_fetch_value(server->route_index, (void*)name);
+
+	return node ? EG_LIST_NODE_VALUE(node) : NULL;
 }
 
 void rename_route_t(Route_t *route, const char *name)
 {
+	ListNode *node = dict_fetch_value(server->route_index, route->name);
+
+	dict_delete(server->route_index, route->name);
+
 	memcpy(route->name, name, strlenz(name));
+
+	if (node) {
+		dict_add(server->route_index, route->name, node);
+	}
 }
 
 uint32_t get_queue_number_route_t(Route_t *route)
@@ -217,6 +238,21 @@ uint32_t get_queue_number_route_t(Route_t *route)
 	return queues;
 }
 
+static int writable_queues_route_t(List *queues)
+{
+	ListIterator iterator;
+	ListNode *node;
+
+	list_rewind(queues, &iterator);
+	while ((node = list_next_node(&iterator)) != NULL)
+	{
+		if (!aof_writable(EG_LIST_NODE_VALUE(node)))
+			return 0;
+	}
+
+	return 1;
+}
+
 static inline void unbind_queues_key_route_t(Route_t *route, List *queues, const char *key)
 {
 	ListIterator iterator;
@@ -32,9 +32,11 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "eagle.h"
 #include "storage.h"
+#include "aof.h"
 #include "version.h"
 #include "protocol.h"
 #include "list.h"
@@ -50,107 +52,380 @@
 #include "xmalloc.h"
 #include "utils.h"
 
-static int storage_write(FILE *fp, void *buffer, size_t length)
+typedef struct StorageCodec {
+	const char *name;
+	unsigned int (*compress)(const void *const in, unsigned int inlen, void *out, unsigned int outlen);
+	unsigned int (*decompress)(const void *const in, unsigned int inlen, void *out, unsigned int outlen);
+} StorageCodec;
+
+typedef struct StorageWriter {
+	int fd;
+	char *buffer;
+	size_t length;
+	size_t size;
+	StorageCodec *codec;
+	char *block;
+	uint32_t block_length;
+	char *scratch;
+} StorageWriter;
+
+typedef struct StorageReader {
+	FILE *fp;
+	int version;
+	StorageCodec *codec;
+	char *block;
+	uint32_t block_length;
+	uint32_t position;
+	char *scratch;
+} StorageReader;
+
+typedef struct StorageQueue {
+	Queue_t *queue_t;
+	Queue_t data;
+	uint32_t size;
+	uint64_t head;
+	QueueIterator iterator;
+	Message *messages;
+	uint32_t length;
+	uint32_t capacity;
+	uint32_t next;
+	Message *unconfirmed;
+	uint32_t unconfirmed_length;
+	uint32_t unconfirmed_capacity;
+	uint32_t unconfirmed_next;
+	int started;
+} StorageQueue;
+
+typedef struct StorageSnapshot {
+	int fd;
+	StorageWriter writer;
+	StorageWriter tail;
+	char tmpfile[32];
+	char *filename;
+	StorageQueue *queues;
+	uint32_t count;
+	uint32_t current;
+} StorageSnapshot;
+
+static StorageSnapshot *snapshot = NULL;
+
+static StorageCodec storage_codecs[] = {
+	[EG_STORAGE_CODEC_NONE] = {"none", NULL, NULL},
+	[EG_STORAGE_CODEC_LZF] = {"lzf", lzf_compress, lzf_decompress}
+};
+
+#define EG_STORAGE_CODECS (sizeof(storage_codecs) / sizeof(storage_codecs[0]))
+
+static void storage_writer_init(StorageWriter *writer, int fd, size_t size)
 {
-	if (fwrite(buffer, length, 1, fp) == 0)
-		return -1;
+	writer->fd = fd;
+	writer->buffer = (char*)xmalloc(size);
+	writer->length = 0;
+	writer->size = size;
+	writer->codec = NULL;
+	writer->block = NULL;
+	writer->block_length = 0;
+	writer->scratch = NULL;
+}
 
-	return length;
+static void storage_writer_set_codec(StorageWriter *writer, StorageCodec *codec)
+{
+	writer->codec = codec;
+	writer->block = (char*)xmalloc(EG_STORAGE_BLOCK_SIZE);
+	writer->block_length = 0;
+
+	if (codec->compress) {
+		writer->scratch = (char*)xmalloc(EG_STORAGE_BLOCK_SIZE);
+	}
 }
 
-static int storage_read(FILE *fp, void *buffer, size_t length)
+static void storage_writer_release(StorageWriter *writer)
 {
-	if (fread(buffer, length, 1, fp) == 0)
-		return -1;
+	xfree(writer->buffer);
+	xfree(writer->block);
+	xfree(writer->scratch);
 
-	return length;
+	writer->buffer = NULL;
+	writer->block = NULL;
+	writer->scratch = NULL;
 }
 
-static int storage_write_type(FILE *fp, unsigned char type)
+static int storage_write_fd(int fd, char *buffer, size_t length)
 {
-	return storage_write(fp, &type, 1);
+	ssize_t nwritten;
+
+	while (length)
+	{
+		nwritten = write(fd, buffer, length);
+
+		if (nwritten == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return EG_STATUS_ERR;
+		}
+
+		buffer += nwritten;
+		length -= nwritten;
+	}
+
+	return EG_STATUS_OK;
 }
 
-static int storage_read_type(FILE *fp)
+static int storage_writer_flush(StorageWriter *writer)
 {
-	unsigned char type;
+	if (writer->fd == -1 || !writer->length)
+		return EG_STATUS_OK;
 
-	if (storage_read(fp, &type, 1) == -1)
-		return -1;
+	if (storage_write_fd(writer->fd, writer->buffer, writer->length) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
 
-	return type;
+	writer->length = 0;
+
+	return EG_STATUS_OK;
 }
 
-static int storage_write_lzf_data(FILE *fp, void *data, uint32_t length)
+static int storage_writer_append(StorageWriter *writer, void *buffer, size_t length)
 {
-	uint32_t comprlen, outlen;
-	void *out;
+	if (writer->length + length > writer->size)
+	{
+		if (writer->fd == -1)
+		{
+			while (writer->length + length > writer->size) {
+				writer->size *= 2;
+			}
 
-	if (length <= 4)
-		return 0;
+			writer->buffer = (char*)xrealloc(writer->buffer, writer->size);
+		}
+		else
+		{
+			if (storage_writer_flush(writer) != EG_STATUS_OK)
+				return -1;
 
-	outlen = length - 4;
-	out = xmalloc(outlen + 1);
+			if (length >= writer->size)
+				return (storage_write_fd(writer->fd, buffer, length) == EG_STATUS_OK) ? (int)length : -1;
+		}
+	}
 
-	comprlen = lzf_compress(data, length, out, outlen);
-	if (comprlen == 0) {
-		xfree(out);
-		return 0;
+	memcpy(writer->buffer + writer->length, buffer, length);
+	writer->length += length;
+
+	return length;
+}
+
+static int storage_writer_write_block(StorageWriter *writer)
+{
+	uint32_t length = writer->block_length;
+	uint32_t comprlen = 0;
+
+	if (!length)
+		return EG_STATUS_OK;
+
+	if (writer->codec->compress)
+		comprlen = writer->codec->compress(writer->block, length, writer->scratch, length - 1);
+
+	if (storage_writer_append(writer, &length, sizeof(length)) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_writer_append(writer, &comprlen, sizeof(comprlen)) == -1)
+		return EG_STATUS_ERR;
+
+	if (comprlen)
+	{
+		if (storage_writer_append(writer, writer->scratch, comprlen) == -1)
+			return EG_STATUS_ERR;
+	}
+	else
+	{
+		if (storage_writer_append(writer, writer->block, length) == -1)
+			return EG_STATUS_ERR;
 	}
 
-	if (storage_write(fp, &length, sizeof(length)) == -1)
-		goto error;
+	writer->block_length = 0;
 
-	if (storage_write(fp, &comprlen, sizeof(comprlen)) == -1)
-		goto error;
+	return EG_STATUS_OK;
+}
 
-	if (storage_write(fp, out, comprlen) == -1)
-		goto error;
+static int storage_writer_finish(StorageWriter *writer)
+{
+	if (writer->block && storage_writer_write_block(writer) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
 
-	xfree(out);
+	return storage_writer_flush(writer);
+}
 
-	return 1;
+static int storage_write(StorageWriter *writer, void *buffer, size_t length)
+{
+	char *data = buffer;
+	size_t left = length;
+	size_t size;
 
-error:
-	xfree(out);
-	return -1;
+	if (!writer->block)
+		return storage_writer_append(writer, buffer, length);
+
+	while (left)
+	{
+		size = EG_STORAGE_BLOCK_SIZE - writer->block_length;
+		if (size > left) {
+			size = left;
+		}
+
+		memcpy(writer->block + writer->block_length, data, size);
+		writer->block_length += size;
+		data += size;
+		left -= size;
+
+		if (writer->block_length == EG_STORAGE_BLOCK_SIZE)
+		{
+			if (storage_writer_write_block(writer) != EG_STATUS_OK)
+				return -1;
+		}
+	}
+
+	return length;
 }
 
-static int storage_write_data(FILE *fp, void *data, uint32_t length)
+static void storage_reader_init(StorageReader *reader, FILE *fp)
 {
-	int err;
-	uint32_t comprlen = 0;
+	reader->fp = fp;
+	reader->version = 0;
+	reader->codec = NULL;
+	reader->block = NULL;
+	reader->block_length = 0;
+	reader->position = 0;
+	reader->scratch = NULL;
+}
+
+static void storage_reader_release(StorageReader *reader)
+{
+	xfree(reader->block);
+	xfree(reader->scratch);
+}
 
-	err = storage_write_lzf_data(fp, data, length);
+static int storage_reader_read_block(StorageReader *reader)
+{
+	uint32_t length;
+	uint32_t comprlen;
 
-	if (err == -1)
+	if (fread(&length, sizeof(length), 1, reader->fp) == 0)
 		return EG_STATUS_ERR;
 
-	if (err)
-		return EG_STATUS_OK;
+	if (fread(&comprlen, sizeof(comprlen), 1, reader->fp) == 0)
+		return EG_STATUS_ERR;
 
-	if (storage_write(fp, &comprlen, sizeof(comprlen)) == -1)
+	if (!length || length > EG_STORAGE_BLOCK_SIZE || comprlen >= length)
 		return EG_STATUS_ERR;
 
-	if (storage_write(fp, &length, sizeof(length)) == -1)
+	if (comprlen)
+	{
+		if (!reader->codec->decompress)
+			return EG_STATUS_ERR;
+
+		if (fread(reader->scratch, comprlen, 1, reader->fp) == 0)
+			return EG_STATUS_ERR;
+
+		if (reader->codec->decompress(reader->scratch, comprlen, reader->block, length) != length)
+			return EG_STATUS_ERR;
+	}
+	else
+	{
+		if (fread(reader->block, length, 1, reader->fp) == 0)
+			return EG_STATUS_ERR;
+	}
+
+	reader->block_length = length;
+	reader->position = 0;
+
+	return EG_STATUS_OK;
+}
+
+static int storage_read(StorageReader *reader, void *buffer, size_t length)
+{
+	char *data = buffer;
+	size_t left = length;
+	size_t size;
+
+	if (!reader->block)
+	{
+		if (fread(buffer, length, 1, reader->fp) == 0)
+			return -1;
+
+		return length;
+	}
+
+	while (left)
+	{
+		if (reader->position == reader->block_length)
+		{
+			if (storage_reader_read_block(reader) != EG_STATUS_OK)
+				return -1;
+		}
+
+		size = reader->block_length - reader->position;
+		if (size > left) {
+			size = left;
+		}
+
+		memcpy(data, reader->block + reader->position, size);
+		reader->position += size;
+		data += size;
+		left -= size;
+	}
+
+	return length;
+}
+
+static int storage_write_type(StorageWriter *writer, unsigned char type)
+{
+	return storage_write(writer, &type, 1);
+}
+
+static int storage_read_type(StorageReader *reader)
+{
+	unsigned char type;
+
+	if (storage_read(reader, &type, 1) == -1)
+		return -1;
+
+	return type;
+}
+
+static int storage_write_data(StorageWriter *writer, void *data, uint32_t length)
+{
+	if (storage_write(writer, &length, sizeof(length)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write(fp, data, length) == -1)
+	if (storage_write(writer, data, length) == -1)
 		return EG_STATUS_ERR;
 
 	return EG_STATUS_OK;
 }
 
-static int storage_read_data(FILE *fp, void *data, uint32_t maxlen)
+static int storage_read_data(StorageReader *reader, void *data, uint32_t maxlen)
 {
 	uint32_t comprlen;
 	uint32_t length;
 	void *compressed;
 
-	if (storage_read(fp, &comprlen, sizeof(comprlen)) == -1)
+	if (reader->version > 1)
+	{
+		if (storage_read(reader, &length, sizeof(length)) == -1)
+			return EG_STATUS_ERR;
+
+		if (length > maxlen)
+			return EG_STATUS_ERR;
+
+		if (storage_read(reader, data, length) == -1)
+			return EG_STATUS_ERR;
+
+		return EG_STATUS_OK;
+	}
+
+	if (storage_read(reader, &comprlen, sizeof(comprlen)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read(fp, &length, sizeof(length)) == -1)
+	if (storage_read(reader, &length, sizeof(length)) == -1)
 		return EG_STATUS_ERR;
 
 	if ((length > maxlen && !comprlen) || comprlen > maxlen)
@@ -160,7 +435,7 @@ static int storage_read_data(FILE *fp, void *data, uint32_t maxlen)
 	{
 		compressed = xmalloc(length);
 
-		if (storage_read(fp, compressed, length) == -1) {
+		if (storage_read(reader, compressed, length) == -1) {
 			xfree(compressed);
 			return EG_STATUS_ERR;
 		}
@@ -174,79 +449,101 @@ static int storage_read_data(FILE *fp, void *data, uint32_t maxlen)
 	}
 	else
 	{
-		if (storage_read(fp, data, length) == -1)
+		if (storage_read(reader, data, length) == -1)
 			return EG_STATUS_ERR;
 	}
 
 	return EG_STATUS_OK;
 }
 
-static Object *storage_read_data_object(FILE *fp)
+static Object *storage_read_data_object(StorageReader *reader)
 {
 	uint32_t comprlen;
 	uint32_t length;
 	void *compressed;
-	void *data;
+	Object *object;
+
+	if (reader->version > 1)
+	{
+		if (storage_read(reader, &length, sizeof(length)) == -1)
+			return NULL;
 
-	if (storage_read(fp, &comprlen, sizeof(comprlen)) == -1)
+		object = create_buffer_object(length);
+
+		if (storage_read(reader, EG_OBJECT_DATA(object), length) == -1) {
+			release_object(object);
+			return NULL;
+		}
+
+		return object;
+	}
+
+	if (storage_read(reader, &comprlen, sizeof(comprlen)) == -1)
 		return NULL;
 
-	if (storage_read(fp, &length, sizeof(length)) == -1)
+	if (storage_read(reader, &length, sizeof(length)) == -1)
 		return NULL;
 
 	if (comprlen)
 	{
 		compressed = xmalloc(length);
 
-		if (storage_read(fp, compressed, length) == -1) {
+		if (storage_read(reader, compressed, length) == -1) {
 			xfree(compressed);
 			return NULL;
 		}
 
-		data = xmalloc(comprlen);
+		object = create_buffer_object(comprlen);
 
-		if (lzf_decompress(compressed, length, data, comprlen) == 0) {
+		if (lzf_decompress(compressed, length, EG_OBJECT_DATA(object), comprlen) == 0) {
 			xfree(compressed);
-			xfree(data);
+			release_object(object);
 			return NULL;
 		}
 
 		xfree(compressed);
 
-		return create_object(data, comprlen);
+		return object;
 	}
 	else
 	{
-		data = xmalloc(length);
+		object = create_buffer_object(length);
 
-		if (storage_read(fp, data, length) == -1) {
-			xfree(data);
+		if (storage_read(reader, EG_OBJECT_DATA(object), length) == -1) {
+			release_object(object);
 			return NULL;
 		}
 
-		return create_object(data, length);
+		return object;
 	}
 
 	return NULL;
 }
 
-static int storage_write_magic(FILE *fp)
+static int storage_write_magic(StorageWriter *writer)
 {
 	char magic[16];
+	unsigned char codec = server->storage_codec;
 
 	snprintf(magic, sizeof(magic), "EagleMQ%04d", EG_STORAGE_VERSION);
-	if (storage_write(fp, magic, 11) == -1)
+	if (storage_write(writer, magic, 11) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_write(writer, &codec, sizeof(codec)) == -1)
 		return EG_STATUS_ERR;
 
+	storage_writer_set_codec(writer, &storage_codecs[codec]);
+
 	return EG_STATUS_OK;
 }
 
-static int storage_read_magic(FILE *fp)
+static int storage_read_magic(StorageReader *reader)
 {
 	char magic[16];
+	unsigned char codec;
 	int version;
 
-	if (storage_read(fp, magic, 11) == -1)
+	if (storage_read(reader, magic, 11) == -1)
 		return EG_STATUS_ERR;
 
 	magic[11] = '\0';
@@ -263,27 +560,55 @@ static int storage_read_magic(FILE *fp)
 		return EG_STATUS_ERR;
 	}
 
+	reader->version = version;
+
+	if (version == 1)
+		return EG_STATUS_OK;
+
+	if (storage_read(reader, &codec, sizeof(codec)) == -1)
+		return EG_STATUS_ERR;
+
+	if (codec >= EG_STORAGE_CODECS) {
+		warning("Unknown storage compression: %d", codec);
+		return EG_STATUS_ERR;
+	}
+
+	reader->codec = &storage_codecs[codec];
+	reader->block = (char*)xmalloc(EG_STORAGE_BLOCK_SIZE);
+	reader->scratch = (char*)xmalloc(EG_STORAGE_BLOCK_SIZE);
+
 	return EG_STATUS_OK;
 }
 
-static int storage_save_user(FILE *fp, EagleUser *user)
+static int storage_save_aof(StorageWriter *writer)
 {
-	if (storage_write_type(fp, EG_STORAGE_TYPE_USER) == -1)
+	if (storage_write_type(writer, EG_STORAGE_TYPE_AOF) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, user->name, strlenz(user->name)) == -1)
+	if (storage_write_data(writer, &server->aof_seq, sizeof(server->aof_seq)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, user->password, strlenz(user->password)) == -1)
+	return EG_STATUS_OK;
+}
+
+static int storage_save_user(StorageWriter *writer, EagleUser *user)
+{
+	if (storage_write_type(writer, EG_STORAGE_TYPE_USER) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &user->perm, sizeof(user->perm)) == -1)
+	if (storage_write_data(writer, user->name, strlenz(user->name)) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_write_data(writer, user->password, strlenz(user->password)) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_write_data(writer, &user->perm, sizeof(user->perm)) == -1)
 		return EG_STATUS_ERR;
 
 	return EG_STATUS_OK;
 }
 
-static int storage_save_users(FILE *fp)
+static int storage_save_users(StorageWriter *writer)
 {
 	ListIterator iterator;
 	ListNode *node;
@@ -297,40 +622,79 @@ static int storage_save_users(FILE *fp)
 		if (BIT_CHECK(user->perm, EG_USER_NOT_CHANGE_PERM))
 			continue;
 
-		if (storage_save_user(fp, user) != EG_STATUS_OK)
+		if (storage_save_user(writer, user) != EG_STATUS_OK)
 			return EG_STATUS_ERR;
 	}
 
 	return EG_STATUS_OK;
 }
 
-static int storage_save_queue_message(FILE *fp, Message *msg)
+static int storage_save_queue_message(StorageWriter *writer, Message *msg)
 {
-	if (storage_write_type(fp, EG_STORAGE_TYPE_MESSAGE) == -1)
+	if (storage_write_type(writer, EG_STORAGE_TYPE_MESSAGE) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &msg->expiration, sizeof(msg->expiration)) == -1)
+	if (storage_write_data(writer, &msg->expiration, sizeof(msg->expiration)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, EG_MESSAGE_VALUE(msg), EG_MESSAGE_SIZE(msg)) == -1)
+	if (storage_write_data(writer, EG_MESSAGE_VALUE(msg), EG_MESSAGE_SIZE(msg)) == -1)
 		return EG_STATUS_ERR;
 
 	return EG_STATUS_OK;
 }
 
-static int storage_save_queue_messages(FILE *fp, Queue_t *queue_t)
+static int storage_save_tagged_message(StorageWriter *writer, Message *msg, int type)
+{
+	if (storage_write_type(writer, type) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_write_data(writer, &msg->expiration, sizeof(msg->expiration)) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_write_data(writer, &msg->tag, sizeof(msg->tag)) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_write_data(writer, &msg->confirm, sizeof(msg->confirm)) == -1)
+		return EG_STATUS_ERR;
+
+	if (storage_write_data(writer, EG_MESSAGE_VALUE(msg), EG_MESSAGE_SIZE(msg)) == -1)
+		return EG_STATUS_ERR;
+
+	return EG_STATUS_OK;
+}
+
+static int storage_save_stored_message(StorageWriter *writer, Message *msg)
+{
+	if (server->aof)
+		return storage_save_tagged_message(writer, msg, EG_STORAGE_TYPE_TAGGED_MESSAGE);
+
+	return storage_save_queue_message(writer, msg);
+}
+
+static int storage_save_unconfirmed_messages(StorageWriter *writer, Queue_t *queue_t)
+{
+	unsigned long i;
+
+	for (i = 0; i < EG_HEAP_LENGTH(queue_t->confirm_messages); i++)
+	{
+		if (storage_save_tagged_message(writer, EG_HEAP_ENTRY_VALUE(queue_t->confirm_messages, i),
+			EG_STORAGE_TYPE_UNCONFIRMED_MESSAGE) != EG_STATUS_OK)
+			return EG_STATUS_ERR;
+	}
+
+	return EG_STATUS_OK;
+}
+
+static int storage_save_queue_messages(StorageWriter *writer, Queue_t *queue_t)
 {
 	QueueIterator *iterator;
-	QueueNode *node;
 	Message *msg;
 
 	iterator = queue_get_iterator(queue_t->queue, EG_START_TAIL);
 
-	while ((node = queue_next_node(iterator)) != NULL)
+	while ((msg = queue_next_value(iterator)) != NULL)
 	{
-		msg = EG_QUEUE_NODE_VALUE(node);
-
-		if (storage_save_queue_message(fp, msg) != EG_STATUS_OK) {
+		if (storage_save_stored_message(writer, msg) != EG_STATUS_OK) {
 			queue_release_iterator(iterator);
 			return EG_STATUS_ERR;
 		}
@@ -338,35 +702,56 @@ static int storage_save_queue_messages(FILE *fp, Queue_t *queue_t)
 
 	queue_release_iterator(iterator);
 
+	if (server->aof) {
+		return storage_save_unconfirmed_messages(writer, queue_t);
+	}
+
 	return EG_STATUS_OK;
 }
 
-static int storage_save_queue(FILE *fp, Queue_t *queue_t)
+static uint32_t storage_queue_size(Queue_t *queue_t)
 {
 	uint32_t queue_size = get_size_queue_t(queue_t);
 
-	if (storage_write_type(fp, EG_STORAGE_TYPE_QUEUE) == -1)
+	if (server->aof) {
+		queue_size += EG_HEAP_LENGTH(queue_t->confirm_messages);
+	}
+
+	return queue_size;
+}
+
+static int storage_save_queue_header(StorageWriter *writer, Queue_t *queue_t, uint32_t queue_size)
+{
+	if (storage_write_type(writer, EG_STORAGE_TYPE_QUEUE) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, queue_t->name, strlenz(queue_t->name)) == -1)
+	if (storage_write_data(writer, queue_t->name, strlenz(queue_t->name)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &queue_t->max_msg, sizeof(queue_t->max_msg)) == -1)
+	if (storage_write_data(writer, &queue_t->max_msg, sizeof(queue_t->max_msg)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &queue_t->max_msg_size, sizeof(queue_t->max_msg_size)) == -1)
+	if (storage_write_data(writer, &queue_t->max_msg_size, sizeof(queue_t->max_msg_size)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &queue_t->flags, sizeof(queue_t->flags)) == -1)
+	if (storage_write_data(writer, &queue_t->flags, sizeof(queue_t->flags)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &queue_size, sizeof(queue_size)) == -1)
+	if (storage_write_data(writer, &queue_size, sizeof(queue_size)) == -1)
 		return EG_STATUS_ERR;
 
-	return storage_save_queue_messages(fp, queue_t);
+	return EG_STATUS_OK;
 }
 
-static int storage_save_queues(FILE *fp)
+static int storage_save_queue(StorageWriter *writer, Queue_t *queue_t)
+{
+	if (storage_save_queue_header(writer, queue_t, storage_queue_size(queue_t)) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	return storage_save_queue_messages(writer, queue_t);
+}
+
+static int storage_save_queues(StorageWriter *writer)
 {
 	ListIterator iterator;
 	ListNode *node;
@@ -380,14 +765,14 @@ static int storage_save_queues(FILE *fp)
 		if (!BIT_CHECK(queue_t->flags, EG_QUEUE_DURABLE_FLAG))
 			continue;
 
-		if (storage_save_queue(fp, queue_t) != EG_STATUS_OK)
+		if (storage_save_queue(writer, queue_t) != EG_STATUS_OK)
 			return EG_STATUS_ERR;
 	}
 
 	return EG_STATUS_OK;
 }
 
-static int storage_save_route_key_queues(FILE *fp, List *queues)
+static int storage_save_route_key_queues(StorageWriter *writer, List *queues)
 {
 	ListIterator iterator;
 	ListNode *node;
@@ -398,30 +783,30 @@ static int storage_save_route_key_queues(FILE *fp, List *queues)
 	{
 		queue_t = EG_LIST_NODE_VALUE(node);
 
-		if (storage_write_data(fp, queue_t->name, strlenz(queue_t->name)) == -1)
+		if (storage_write_data(writer, queue_t->name, strlenz(queue_t->name)) == -1)
 			return EG_STATUS_ERR;
 	}
 
 	return EG_STATUS_OK;
 }
 
-static int storage_save_route_key(FILE *fp, const char *key, List *queues)
+static int storage_save_route_key(StorageWriter *writer, const char *key, List *queues)
 {
 	uint32_t queue_size = EG_LIST_LENGTH(queues);
 
-	if (storage_write_type(fp, EG_STORAGE_TYPE_ROUTE_KEY) == -1)
+	if (storage_write_type(writer, EG_STORAGE_TYPE_ROUTE_KEY) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, (void*)key, strlenz(key)) == -1)
+	if (storage_write_data(writer, (void*)key, strlenz(key)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &queue_size, sizeof(queue_size)) == -1)
+	if (storage_write_data(writer, &queue_size, sizeof(queue_size)) == -1)
 		return EG_STATUS_ERR;
 
-	return storage_save_route_key_queues(fp, queues);
+	return storage_save_route_key_queues(writer, queues);
 }
 
-static int storage_save_route_keys(FILE *fp, Route_t *route)
+static int storage_save_route_keys(StorageWriter *writer, Route_t *route)
 {
 	KeylistIterator iterator;
 	KeylistNode *node;
@@ -429,7 +814,7 @@ static int storage_save_route_keys(FILE *fp, Route_t *route)
 	keylist_rewind(route->keys, &iterator);
 	while ((node = keylist_next_node(&iterator)) != NULL)
 	{
-		if (storage_save_route_key(fp, EG_KEYLIST_NODE_KEY(node),
+		if (storage_save_route_key(writer, EG_KEYLIST_NODE_KEY(node),
 			EG_KEYLIST_NODE_VALUE(node)) != EG_STATUS_OK)
 			return EG_STATUS_ERR;
 	}
@@ -437,26 +822,26 @@ static int storage_save_route_keys(FILE *fp, Route_t *route)
 	return EG_STATUS_OK;
 }
 
-static int storage_save_route(FILE *fp, Route_t *route)
+static int storage_save_route(StorageWriter *writer, Route_t *route)
 {
 	uint32_t keys = EG_KEYLIST_LENGTH(route->keys);
 
-	if (storage_write_type(fp, EG_STORAGE_TYPE_ROUTE) == -1)
+	if (storage_write_type(writer, EG_STORAGE_TYPE_ROUTE) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, route->name, strlenz(route->name)) == -1)
+	if (storage_write_data(writer, route->name, strlenz(route->name)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &route->flags, sizeof(route->flags)) == -1)
+	if (storage_write_data(writer, &route->flags, sizeof(route->flags)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &keys, sizeof(keys)) == -1)
+	if (storage_write_data(writer, &keys, sizeof(keys)) == -1)
 		return EG_STATUS_ERR;
 
-	return storage_save_route_keys(fp, route);
+	return storage_save_route_keys(writer, route);
 }
 
-static int storage_save_routes(FILE *fp)
+static int storage_save_routes(StorageWriter *writer)
 {
 	ListIterator iterator;
 	ListNode *node;
@@ -470,28 +855,28 @@ static int storage_save_routes(FILE *fp)
 		if (!BIT_CHECK(route->flags, EG_ROUTE_DURABLE_FLAG))
 			continue;
 
-		if (storage_save_route(fp, route) != EG_STATUS_OK)
+		if (storage_save_route(writer, route) != EG_STATUS_OK)
 			return EG_STATUS_ERR;
 	}
 
 	return EG_STATUS_OK;
 }
 
-static int storage_save_channel(FILE *fp, Channel_t *channel)
+static int storage_save_channel(StorageWriter *writer, Channel_t *channel)
 {
-	if (storage_write_type(fp, EG_STORAGE_TYPE_CHANNEL) == -1)
+	if (storage_write_type(writer, EG_STORAGE_TYPE_CHANNEL) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, channel->name, strlenz(channel->name)) == -1)
+	if (storage_write_data(writer, channel->name, strlenz(channel->name)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_write_data(fp, &channel->flags, sizeof(channel->flags)) == -1)
+	if (storage_write_data(writer, &channel->flags, sizeof(channel->flags)) == -1)
 		return EG_STATUS_ERR;
 
 	return EG_STATUS_OK;
 }
 
-static int storage_save_channels(FILE *fp)
+static int storage_save_channels(StorageWriter *writer)
 {
 	ListIterator iterator;
 	ListNode *node;
@@ -505,24 +890,24 @@ static int storage_save_channels(FILE *fp)
 		if (!BIT_CHECK(channel->flags, EG_CHANNEL_DURABLE_FLAG))
 			continue;
 
-		if (storage_save_channel(fp, channel) != EG_STATUS_OK)
+		if (storage_save_channel(writer, channel) != EG_STATUS_OK)
 			return EG_STATUS_ERR;
 	}
 
 	return EG_STATUS_OK;
 }
 
-static int storage_load_user(FILE *fp)
+static int storage_load_user(StorageReader *reader)
 {
 	EagleUser user;
 
-	if (storage_read_data(fp, user.name, sizeof(user.name)) == -1)
+	if (storage_read_data(reader, user.name, sizeof(user.name)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, user.password, sizeof(user.password)) == -1)
+	if (storage_read_data(reader, user.password, sizeof(user.password)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &user.perm, sizeof(user.perm)) == -1)
+	if (storage_read_data(reader, &user.perm, sizeof(user.perm)) == -1)
 		return EG_STATUS_ERR;
 
 	list_add_value_tail(server->users, create_user(user.name, user.password, user.perm));
@@ -530,71 +915,109 @@ static int storage_load_user(FILE *fp)
 	return EG_STATUS_OK;
 }
 
-static int storage_load_queue_message(FILE *fp, Queue_t *queue_t)
+static int storage_load_tagged_message(StorageReader *reader, Queue_t *queue_t, int type)
 {
 	Object *data;
+	uint64_t tag;
 	uint32_t expiration;
+	uint32_t confirm;
+
+	if (storage_read_data(reader, &expiration, sizeof(expiration)) == -1)
+		return EG_STATUS_ERR;
 
-	if (storage_read_type(fp) != EG_STORAGE_TYPE_MESSAGE)
+	if (storage_read_data(reader, &tag, sizeof(tag)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &expiration, sizeof(expiration)) == -1)
+	if (storage_read_data(reader, &confirm, sizeof(confirm)) == -1)
 		return EG_STATUS_ERR;
 
-	if ((data = storage_read_data_object(fp)) == NULL)
+	if ((data = storage_read_data_object(reader)) == NULL)
+		return EG_STATUS_ERR;
+
+	if (type == EG_STORAGE_TYPE_UNCONFIRMED_MESSAGE) {
+		restore_unconfirmed_message_queue_t(queue_t, data, tag, expiration, confirm);
+	} else {
+		restore_message_queue_t(queue_t, data, tag, expiration);
+	}
+
+	decrement_references_count(data);
+
+	return EG_STATUS_OK;
+}
+
+static int storage_load_queue_message(StorageReader *reader, Queue_t *queue_t)
+{
+	Object *data;
+	uint32_t expiration;
+	int type;
+
+	type = storage_read_type(reader);
+
+	if (type == EG_STORAGE_TYPE_TAGGED_MESSAGE || type == EG_STORAGE_TYPE_UNCONFIRMED_MESSAGE)
+		return storage_load_tagged_message(reader, queue_t, type);
+
+	if (type != EG_STORAGE_TYPE_MESSAGE)
+		return EG_STATUS_ERR;
+
+	if (storage_read_data(reader, &expiration, sizeof(expiration)) == -1)
+		return EG_STATUS_ERR;
+
+	if ((data = storage_read_data_object(reader)) == NULL)
 		return EG_STATUS_ERR;
 
 	push_message_queue_t(queue_t, data, expiration);
 
+	decrement_references_count(data);
+
 	return EG_STATUS_OK;
 }
 
-static int storage_load_queue(FILE *fp)
+static int storage_load_queue(StorageReader *reader)
 {
 	Queue_t *queue_t;
 	Queue_t data;
 	uint32_t queue_size;
 	int i;
 
-	if (storage_read_data(fp, &data.name, sizeof(data.name)) == -1)
+	if (storage_read_data(reader, &data.name, sizeof(data.name)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &data.max_msg, sizeof(data.max_msg)) == -1)
+	if (storage_read_data(reader, &data.max_msg, sizeof(data.max_msg)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &data.max_msg_size, sizeof(data.max_msg_size)) == -1)
+	if (storage_read_data(reader, &data.max_msg_size, sizeof(data.max_msg_size)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &data.flags, sizeof(data.flags)) == -1)
+	if (storage_read_data(reader, &data.flags, sizeof(data.flags)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &queue_size, sizeof(queue_size)) == -1)
+	if (storage_read_data(reader, &queue_size, sizeof(queue_size)) == -1)
 		return EG_STATUS_ERR;
 
 	queue_t = create_queue_t(data.name, data.max_msg, data.max_msg_size, data.flags);
 
 	for (i = 0; i < queue_size; i++)
 	{
-		if (storage_load_queue_message(fp, queue_t) != EG_STATUS_OK) {
+		if (storage_load_queue_message(reader, queue_t) != EG_STATUS_OK) {
 			delete_queue_t(queue_t);
 			return EG_STATUS_ERR;
 		}
 	}
 
-	list_add_value_tail(server->queues, queue_t);
+	register_queue_t(queue_t);
 
 	return EG_STATUS_OK;
 }
 
-static int storage_load_route_key_queues(FILE *fp, Route_t *route, const char *key)
+static int storage_load_route_key_queues(StorageReader *reader, Route_t *route, const char *key)
 {
 	Queue_t *queue_t;
 	char name[64];
 
-	if (storage_read_data(fp, &name, sizeof(name)) == -1)
+	if (storage_read_data(reader, &name, sizeof(name)) == -1)
 		return EG_STATUS_ERR;
 
-	queue_t = find_queue_t(server->queues, name);
+	queue_t = find_queue_t(name);
 	if (!queue_t)
 		return EG_STATUS_OK;
 
@@ -603,24 +1026,24 @@ static int storage_load_route_key_queues(FILE *fp, Route_t *route, const char *k
 	return EG_STATUS_OK;
 }
 
-static int storage_load_route_key(FILE *fp, Route_t *route)
+static int storage_load_route_key(StorageReader *reader, Route_t *route)
 {
 	char key[32];
 	uint32_t queue_size;
 	int i;
 
-	if (storage_read_type(fp) != EG_STORAGE_TYPE_ROUTE_KEY)
+	if (storage_read_type(reader) != EG_STORAGE_TYPE_ROUTE_KEY)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &key, sizeof(key)) == -1)
+	if (storage_read_data(reader, &key, sizeof(key)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &queue_size, sizeof(queue_size)) == -1)
+	if (storage_read_data(reader, &queue_size, sizeof(queue_size)) == -1)
 		return EG_STATUS_ERR;
 
 	for (i = 0; i < queue_size; i++)
 	{
-		if (storage_load_route_key_queues(fp, route, key) != EG_STATUS_OK) {
+		if (storage_load_route_key_queues(reader, route, key) != EG_STATUS_OK) {
 			return EG_STATUS_ERR;
 		}
 	}
@@ -628,57 +1051,71 @@ static int storage_load_route_key(FILE *fp, Route_t *route)
 	return EG_STATUS_OK;
 }
 
-static int storage_load_route(FILE *fp)
+static int storage_load_route(StorageReader *reader)
 {
 	Route_t *route;
 	Route_t data;
 	uint32_t keys;
 	int i;
 
-	if (storage_read_data(fp, &data.name, sizeof(data.name)) == -1)
+	if (storage_read_data(reader, &data.name, sizeof(data.name)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &data.flags, sizeof(data.flags)) == -1)
+	if (storage_read_data(reader, &data.flags, sizeof(data.flags)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &keys, sizeof(keys)) == -1)
+	if (storage_read_data(reader, &keys, sizeof(keys)) == -1)
 		return EG_STATUS_ERR;
 
 	route = create_route_t(data.name, data.flags);
 
 	for (i = 0; i < keys; i++)
 	{
-		if (storage_load_route_key(fp, route) != EG_STATUS_OK) {
+		if (storage_load_route_key(reader, route) != EG_STATUS_OK) {
 			delete_route_t(route);
 			return EG_STATUS_ERR;
 		}
 	}
 
-	list_add_value_tail(server->routes, route);
+	register_route_t(route);
 
 	return EG_STATUS_OK;
 }
 
-static int storage_load_channel(FILE *fp)
+static int storage_load_channel(StorageReader *reader)
 {
 	Channel_t *channel;
 	Channel_t data;
 
-	if (storage_read_data(fp, &data.name, sizeof(data.name)) == -1)
+	if (storage_read_data(reader, &data.name, sizeof(data.name)) == -1)
 		return EG_STATUS_ERR;
 
-	if (storage_read_data(fp, &data.flags, sizeof(data.flags)) == -1)
+	if (storage_read_data(reader, &data.flags, sizeof(data.flags)) == -1)
 		return EG_STATUS_ERR;
 
 	channel = create_channel_t(data.name, data.flags);
 
-	list_add_value_tail(server->channels, channel);
+	register_channel_t(channel);
 
 	return EG_STATUS_OK;
 }
 
+int storage_find_codec(const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int)EG_STORAGE_CODECS; i++)
+	{
+		if (!strcmp(storage_codecs[i].name, name))
+			return i;
+	}
+
+	return EG_STATUS_ERR;
+}
+
 int storage_load(const char *filename)
 {
+	StorageReader reader;
 	FILE *fp;
 	int type;
 	int state = 1;
@@ -689,30 +1126,36 @@ int storage_load(const char *filename)
 		return EG_STATUS_ERR;
 	}
 
-	if (storage_read_magic(fp) != EG_STATUS_OK)
+	storage_reader_init(&reader, fp);
+
+	if (storage_read_magic(&reader) != EG_STATUS_OK)
 		goto error;
 
 	while (state)
 	{
-		if ((type = storage_read_type(fp)) == -1)
+		if ((type = storage_read_type(&reader)) == -1)
 			goto error;
 
 		switch (type)
 		{
 			case EG_STORAGE_TYPE_USER:
-				if (storage_load_user(fp) != EG_STATUS_OK) goto error;
+				if (storage_load_user(&reader) != EG_STATUS_OK) goto error;
 				break;
 
 			case EG_STORAGE_TYPE_QUEUE:
-				if (storage_load_queue(fp) != EG_STATUS_OK) goto error;
+				if (storage_load_queue(&reader) != EG_STATUS_OK) goto error;
 				break;
 
 			case EG_STORAGE_TYPE_ROUTE:
-				if (storage_load_route(fp) != EG_STATUS_OK) goto error;
+				if (storage_load_route(&reader) != EG_STATUS_OK) goto error;
 				break;
 
 			case EG_STORAGE_TYPE_CHANNEL:
-				if (storage_load_channel(fp) != EG_STATUS_OK) goto error;
+				if (storage_load_channel(&reader) != EG_STATUS_OK) goto error;
+				break;
+
+			case EG_STORAGE_TYPE_AOF:
+				if (storage_read_data(&reader, &server->aof_seq, sizeof(server->aof_seq)) == -1) goto error;
 				break;
 
 			case EG_STORAGE_EOF:
@@ -724,11 +1167,13 @@ int storage_load(const char *filename)
 		}
 	}
 
+	storage_reader_release(&reader);
 	fclose(fp);
 
 	return EG_STATUS_OK;
 
 error:
+	storage_reader_release(&reader);
 	fclose(fp);
 
 	fatal("Error read storage %s", filename);
@@ -738,38 +1183,48 @@ error:
 
 int storage_save(const char *filename)
 {
-	FILE *fp;
+	StorageWriter writer;
 	char tmpfile[32];
+	int fd;
 
 	snprintf(tmpfile, sizeof(tmpfile), "eaglemq-%d.dat", (int)getpid());
 
-	fp = fopen(tmpfile, "w");
-	if (!fp) {
+	fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
 		warning("Failed opening storage for saving: %s",  strerror(errno));
 		return EG_STATUS_ERR;
 	}
 
-	if (storage_write_magic(fp) != EG_STATUS_OK)
+	storage_writer_init(&writer, fd, EG_STORAGE_BUFFER_SIZE);
+
+	if (storage_write_magic(&writer) != EG_STATUS_OK)
 		goto error;
 
-	if (storage_save_users(fp) != EG_STATUS_OK)
+	if (server->aof && storage_save_aof(&writer) != EG_STATUS_OK)
 		goto error;
 
-	if (storage_save_queues(fp) != EG_STATUS_OK)
+	if (storage_save_users(&writer) != EG_STATUS_OK)
 		goto error;
 
-	if (storage_save_routes(fp) != EG_STATUS_OK)
+	if (storage_save_queues(&writer) != EG_STATUS_OK)
 		goto error;
 
-	if (storage_save_channels(fp) != EG_STATUS_OK)
+	if (storage_save_routes(&writer) != EG_STATUS_OK)
 		goto error;
 
-	if (storage_write_type(fp, EG_STORAGE_EOF) == -1)
+	if (storage_save_channels(&writer) != EG_STATUS_OK)
 		goto error;
 
-	fflush(fp);
-	fsync(fileno(fp));
-	fclose(fp);
+	if (storage_write_type(&writer, EG_STORAGE_EOF) == -1)
+		goto error;
+
+	if (storage_writer_finish(&writer) != EG_STATUS_OK)
+		goto error;
+
+	storage_writer_release(&writer);
+
+	fsync(fd);
+	close(fd);
 
 	if (rename(tmpfile, filename) == -1)
 	{
@@ -783,19 +1238,390 @@ int storage_save(const char *filename)
 error:
 	warning("Error write data to the storage");
 
-	fclose(fp);
+	storage_writer_release(&writer);
+
+	close(fd);
 	unlink(tmpfile);
 
 	return EG_STATUS_ERR;
 }
 
+static void storage_copy_message(Message **messages, uint32_t *length, uint32_t *capacity, Message *msg)
+{
+	if (*length == *capacity)
+	{
+		*capacity = *capacity ? *capacity * 2 : EG_STORAGE_COPY_MIN_SIZE;
+		*messages = (Message*)xrealloc(*messages, sizeof(Message) * (*capacity));
+	}
+
+	(*messages)[(*length)++] = *msg;
+	increment_references_count(msg->value);
+}
+
+static void storage_release_messages(Message *messages, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < length; i++) {
+		decrement_references_count(messages[i].value);
+	}
+
+	xfree(messages);
+}
+
+static Message *storage_next_snapshot_message(StorageQueue *squeue)
+{
+	Queue *queue;
+
+	if (!squeue->queue_t) {
+		return NULL;
+	}
+
+	queue = squeue->queue_t->queue;
+
+	if ((int64_t)(queue->tail - squeue->iterator.next) > 0) {
+		squeue->iterator.next = queue->tail;
+	}
+
+	if ((int64_t)(squeue->head - squeue->iterator.next) <= 0) {
+		return NULL;
+	}
+
+	return queue_next_value(&squeue->iterator);
+}
+
+static void storage_detach_snapshot_queue(StorageQueue *squeue)
+{
+	if (squeue->queue_t)
+	{
+		squeue->queue_t->snapshot = NULL;
+		squeue->queue_t = NULL;
+	}
+}
+
+static int storage_save_snapshot_queue(StorageWriter *writer, StorageQueue *squeue, long long deadline)
+{
+	Message *msg;
+	int status, count = 0;
+
+	if (!squeue->started)
+	{
+		if (storage_save_queue_header(writer, &squeue->data, squeue->size) != EG_STATUS_OK)
+			return EG_STATUS_ERR;
+
+		squeue->started = 1;
+	}
+
+	while (1)
+	{
+		if (++count % EG_STORAGE_SLICE_MESSAGES == 0 && ustime() > deadline)
+			return 0;
+
+		if (squeue->next < squeue->length)
+		{
+			status = storage_save_stored_message(writer, &squeue->messages[squeue->next++]);
+		}
+		else if ((msg = storage_next_snapshot_message(squeue)) != NULL)
+		{
+			status = storage_save_stored_message(writer, msg);
+		}
+		else if (squeue->unconfirmed_next < squeue->unconfirmed_length)
+		{
+			storage_detach_snapshot_queue(squeue);
+			status = storage_save_tagged_message(writer, &squeue->unconfirmed[squeue->unconfirmed_next++],
+				EG_STORAGE_TYPE_UNCONFIRMED_MESSAGE);
+		}
+		else
+		{
+			storage_detach_snapshot_queue(squeue);
+			return 1;
+		}
+
+		if (status != EG_STATUS_OK)
+			return EG_STATUS_ERR;
+	}
+}
+
+static void storage_release_snapshot(void)
+{
+	StorageQueue *squeue;
+	uint32_t i;
+
+	for (i = 0; i < snapshot->count; i++)
+	{
+		squeue = &snapshot->queues[i];
+
+		storage_detach_snapshot_queue(squeue);
+		storage_release_messages(squeue->messages, squeue->length);
+		storage_release_messages(squeue->unconfirmed, squeue->unconfirmed_length);
+	}
+
+	if (snapshot->fd != -1) {
+		close(snapshot->fd);
+	}
+
+	storage_writer_release(&snapshot->writer);
+	storage_writer_release(&snapshot->tail);
+
+	xfree(snapshot->queues);
+	xfree(snapshot->filename);
+	xfree(snapshot);
+
+	snapshot = NULL;
+}
+
+static void storage_finish_snapshot(int status)
+{
+	StorageWriter *writer = &snapshot->writer;
+
+	if (status == EG_STATUS_OK)
+	{
+		if (storage_write(writer, snapshot->tail.buffer, snapshot->tail.length) == -1 ||
+			storage_writer_finish(writer) != EG_STATUS_OK || fsync(snapshot->fd) == -1) {
+			status = EG_STATUS_ERR;
+		}
+	}
+
+	close(snapshot->fd);
+	snapshot->fd = -1;
+
+	if (status == EG_STATUS_OK && rename(snapshot->tmpfile, snapshot->filename) == -1)
+	{
+		warning("Error rename temp storage file %s to %s: %s",
+			snapshot->tmpfile, snapshot->filename, strerror(errno));
+		status = EG_STATUS_ERR;
+	}
+
+	if (status != EG_STATUS_OK)
+	{
+		warning("Error background saving data in %s", snapshot->filename);
+		unlink(snapshot->tmpfile);
+	}
+
+	aof_rotate_done(status);
+
+	storage_release_snapshot();
+}
+
+static int storage_pause_snapshot(void)
+{
+	if (storage_writer_flush(&snapshot->writer) != EG_STATUS_OK) {
+		storage_finish_snapshot(EG_STATUS_ERR);
+		return -1;
+	}
+
+#ifdef SYNC_FILE_RANGE_WRITE
+	sync_file_range(snapshot->fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+
+	return EG_STORAGE_SLICE_INTERVAL;
+}
+
+static int storage_save_step(EventLoop *loop, long long id, void *data)
+{
+	long long deadline = ustime() + EG_STORAGE_SLICE_TIME;
+	int status;
+
+	EG_NOTUSED(loop);
+	EG_NOTUSED(id);
+	EG_NOTUSED(data);
+
+	while (snapshot->current < snapshot->count)
+	{
+		status = storage_save_snapshot_queue(&snapshot->writer, &snapshot->queues[snapshot->current], deadline);
+
+		if (status == EG_STATUS_ERR) {
+			storage_finish_snapshot(EG_STATUS_ERR);
+			return -1;
+		}
+
+		if (status == 0) {
+			return storage_pause_snapshot();
+		}
+
+		snapshot->current++;
+
+		if (ustime() > deadline) {
+			return storage_pause_snapshot();
+		}
+	}
+
+	storage_finish_snapshot(EG_STATUS_OK);
+
+	return -1;
+}
+
+static int storage_save_snapshot_tail(void)
+{
+	StorageWriter *writer = &snapshot->tail;
+
+	storage_writer_init(writer, -1, EG_STORAGE_TAIL_SIZE);
+
+	if (storage_save_routes(writer) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (storage_save_channels(writer) != EG_STATUS_OK)
+		return EG_STATUS_ERR;
+
+	if (storage_write_type(writer, EG_STORAGE_EOF) == -1)
+		return EG_STATUS_ERR;
+
+	return EG_STATUS_OK;
+}
+
+static void storage_prepare_snapshot_queues(void)
+{
+	ListIterator iterator;
+	ListNode *node;
+	Queue_t *queue_t;
+	StorageQueue *squeue;
+	unsigned long i;
+
+	snapshot->queues = (StorageQueue*)xcalloc(sizeof(StorageQueue) * (EG_LIST_LENGTH(server->queues) + 1));
+
+	list_rewind(server->queues, &iterator);
+	while ((node = list_next_node(&iterator)) != NULL)
+	{
+		queue_t = EG_LIST_NODE_VALUE(node);
+
+		if (!BIT_CHECK(queue_t->flags, EG_QUEUE_DURABLE_FLAG))
+			continue;
+
+		squeue = &snapshot->queues[snapshot->count++];
+
+		squeue->queue_t = queue_t;
+		squeue->data = *queue_t;
+		squeue->size = storage_queue_size(queue_t);
+		squeue->head = queue_t->queue->head;
+
+		rewind_messages_queue_t(queue_t, &squeue->iterator);
+
+		if (server->aof)
+		{
+			for (i = 0; i < EG_HEAP_LENGTH(queue_t->confirm_messages); i++)
+			{
+				storage_copy_message(&squeue->unconfirmed, &squeue->unconfirmed_length,
+					&squeue->unconfirmed_capacity, EG_HEAP_ENTRY_VALUE(queue_t->confirm_messages, i));
+			}
+		}
+
+		queue_t->snapshot = squeue;
+	}
+}
+
+static int storage_save_incremental(const char *filename)
+{
+	aof_rotate();
+
+	snapshot = (StorageSnapshot*)xcalloc(sizeof(*snapshot));
+	snapshot->fd = -1;
+
+	snprintf(snapshot->tmpfile, sizeof(snapshot->tmpfile), "eaglemq-%d-inc.dat", (int)getpid());
+
+	snapshot->fd = open(snapshot->tmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (snapshot->fd == -1) {
+		warning("Failed opening storage for saving: %s",  strerror(errno));
+		goto error;
+	}
+
+	storage_writer_init(&snapshot->writer, snapshot->fd, EG_STORAGE_BUFFER_SIZE);
+
+	if (storage_write_magic(&snapshot->writer) != EG_STATUS_OK)
+		goto error;
+
+	if (server->aof && storage_save_aof(&snapshot->writer) != EG_STATUS_OK)
+		goto error;
+
+	if (storage_save_users(&snapshot->writer) != EG_STATUS_OK)
+		goto error;
+
+	if (storage_save_snapshot_tail() != EG_STATUS_OK)
+		goto error;
+
+	snapshot->filename = xstrdup(filename);
+
+	storage_prepare_snapshot_queues();
+
+	create_time_event(server->loop, EG_STORAGE_SLICE_INTERVAL, storage_save_step, NULL, NULL);
+
+	return EG_STATUS_OK;
+
+error:
+	warning("Error write data to the storage");
+
+	if (snapshot->fd != -1) {
+		unlink(snapshot->tmpfile);
+	}
+
+	storage_release_snapshot();
+
+	return EG_STATUS_ERR;
+}
+
+void storage_freeze_queue(Queue_t *queue_t)
+{
+	StorageQueue *squeue = queue_t->snapshot;
+	Message *msg;
+
+	if (!squeue) {
+		return;
+	}
+
+	while ((msg = storage_next_snapshot_message(squeue)) != NULL) {
+		storage_copy_message(&squeue->messages, &squeue->length, &squeue->capacity, msg);
+	}
+
+	storage_detach_snapshot_queue(squeue);
+}
+
+void storage_freeze_tail_message(Queue_t *queue_t)
+{
+	StorageQueue *squeue = queue_t->snapshot;
+	Message *msg;
+
+	if (!squeue || squeue->iterator.next != queue_t->queue->tail) {
+		return;
+	}
+
+	if ((msg = storage_next_snapshot_message(squeue)) != NULL) {
+		storage_copy_message(&squeue->messages, &squeue->length, &squeue->capacity, msg);
+	}
+}
+
+int storage_save_in_progress(void)
+{
+	return server->child_pid != -1 || snapshot != NULL;
+}
+
+void storage_save_cancel(void)
+{
+	if (!snapshot) {
+		return;
+	}
+
+	close(snapshot->fd);
+	snapshot->fd = -1;
+
+	unlink(snapshot->tmpfile);
+
+	storage_release_snapshot();
+}
+
 int storage_save_background(const char *filename)
 {
 	pid_t child_pid;
+	long long start;
 
-	if (server->child_pid != -1)
+	if (storage_save_in_progress())
 		return EG_STATUS_ERR;
 
+	if (server->save_mode == EG_SAVE_MODE_INCREMENTAL)
+		return storage_save_incremental(filename);
+
+	aof_rotate();
+
+	start = ustime();
+
 	if ((child_pid = fork()) == 0)
 	{
 		if (server->fd > 0)
@@ -814,6 +1640,7 @@ int storage_save_background(const char *filename)
 			return EG_STATUS_ERR;
 		}
 
+		server->fork_time = ustime() - start;
 		server->child_pid = child_pid;
 	}
 
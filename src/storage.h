@@ -28,7 +28,9 @@
 #ifndef __STORAGE_H__
 #define __STORAGE_H__
 
-#define EG_STORAGE_VERSION 1
+#include "eagle.h"
+
+#define EG_STORAGE_VERSION 2
 
 #define EG_STORAGE_TYPE_USER 0x1
 #define EG_STORAGE_TYPE_QUEUE 0x2
@@ -36,12 +38,29 @@
 #define EG_STORAGE_TYPE_ROUTE 0x4
 #define EG_STORAGE_TYPE_ROUTE_KEY 0x5
 #define EG_STORAGE_TYPE_CHANNEL 0x6
+#define EG_STORAGE_TYPE_AOF 0x7
+#define EG_STORAGE_TYPE_TAGGED_MESSAGE 0x8
+#define EG_STORAGE_TYPE_UNCONFIRMED_MESSAGE 0x9
 
 #define EG_STORAGE_EOF 0xFF
 
+#define EG_STORAGE_BUFFER_SIZE 1048576
+#define EG_STORAGE_BLOCK_SIZE 65536
+#define EG_STORAGE_TAIL_SIZE 4096
+
+#define EG_STORAGE_SLICE_TIME 1000
+#define EG_STORAGE_SLICE_INTERVAL 1
+#define EG_STORAGE_SLICE_MESSAGES 64
+#define EG_STORAGE_COPY_MIN_SIZE 16
+
+int storage_find_codec(const char *name);
 int storage_load(const char *filename);
 int storage_save(const char *filename);
 int storage_save_background(const char *filename);
+int storage_save_in_progress(void);
+void storage_save_cancel(void);
+void storage_freeze_queue(Queue_t *queue_t);
+void storage_freeze_tail_message(Queue_t *queue_t);
 void remove_temp_file(pid_t pid);
 
 #endif
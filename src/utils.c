@@ -35,6 +35,7 @@
 #include <limits.h>
 #include <ctype.h>
 #include <time.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -146,7 +147,7 @@ int pattern_match_length(const char *string, int slength, const char *pattern, i
 
 				while(slength)
 				{
-					if (pattern_match_length(pattern + 1, plength - 1, string, slength, nocase))
+					if (pattern_match_length(string, slength, pattern + 1, plength - 1, nocase))
 						return 1;
 
 					string++;
@@ -290,6 +291,19 @@ int pattern_match(const char *string, const char *pattern, int nocase)
 	return pattern_match_length(string, strlen(string), pattern, strlen(pattern), nocase);
 }
 
+long long ustime(void)
+{
+	struct timeval tv;
+	long long ust;
+
+	gettimeofday(&tv, NULL);
+
+	ust = ((long long)tv.tv_sec) * 1000000;
+	ust += tv.tv_usec;
+
+	return ust;
+}
+
 uint64_t make_message_tag(uint32_t msg_counter, uint32_t time)
 {
 	uint64_t id = 0;
@@ -55,6 +55,7 @@ void wlog(const char *fmt,...);
 int pattern_match_length(const char *string, int slength, const char *pattern, int plength, int nocase);
 int pattern_match(const char *string, const char *pattern, int nocase);
 
+long long ustime(void);
 uint64_t make_message_tag(uint32_t msg_counter, uint32_t time);
 
 long long memtoll(const char *value, int *err);
@@ -25,12 +25,16 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include "fmacros.h"
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <malloc.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <pthread.h>
@@ -53,11 +57,13 @@
 #define calloc(count,size) tc_calloc(count,size)
 #define realloc(ptr,size) tc_realloc(ptr,size)
 #define free(ptr) tc_free(ptr)
+#define posix_memalign(ptr,align,size) tc_posix_memalign(ptr,align,size)
 #elif defined(_USE_JEMALLOC_)
 #define malloc(size) je_malloc(size)
 #define calloc(count,size) je_calloc(count,size)
 #define realloc(ptr,size) je_realloc(ptr,size)
 #define free(ptr) je_free(ptr)
+#define posix_memalign(ptr,align,size) je_posix_memalign(ptr,align,size)
 #endif
 
 #ifdef HAVE_ATOMIC
@@ -97,10 +103,40 @@
 	} \
 } while(0)
 
+#define XSLAB_CLASS(__n) (((__n) + XSLAB_ALIGN - 1) / XSLAB_ALIGN - 1)
+#define XSLAB_CHUNK_SIZE(__c) (((__c) + 1) * XSLAB_ALIGN)
+#define XSLAB_PAGE(__p) ((SlabPage*)((uintptr_t)(__p) & ~((uintptr_t)XSLAB_PAGE_SIZE - 1)))
+#define XSLAB_HEADER_SIZE ((sizeof(SlabPage) + XSLAB_ALIGN - 1) & ~(XSLAB_ALIGN - 1))
+
+typedef struct SlabPage {
+	struct SlabPage *prev;
+	struct SlabPage *next;
+	void *free;
+	char *unused;
+	unsigned int inuse;
+	unsigned int sclass;
+} SlabPage;
+
+typedef struct SlabClass {
+	SlabPage *pages;
+} SlabClass;
+
+#define XARENA_BLOCK_SIZE(__c) ((size_t)XARENA_MIN_SIZE << (__c))
+
+typedef struct ArenaBlock {
+	struct ArenaBlock *next;
+} ArenaBlock;
+
 static size_t used_memory = 0;
 static int xmalloc_state_lock = 0;
 pthread_mutex_t memory_stat_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static SlabClass slab_classes[XSLAB_CLASSES];
+static size_t slab_memory = 0;
+
+static ArenaBlock *arena_classes[XARENA_CLASSES];
+static size_t arena_memory = 0;
+
 void *xmalloc(size_t size)
 {
 	void *ptr = malloc(size + PREFIX_SIZE);
@@ -210,6 +246,252 @@ void xfree(void *ptr)
 #endif
 }
 
+static void xslab_link_page(SlabClass *sclass, SlabPage *page)
+{
+	page->prev = NULL;
+	page->next = sclass->pages;
+
+	if (sclass->pages) {
+		sclass->pages->prev = page;
+	}
+
+	sclass->pages = page;
+}
+
+static void xslab_unlink_page(SlabClass *sclass, SlabPage *page)
+{
+	if (page->prev) {
+		page->prev->next = page->next;
+	} else {
+		sclass->pages = page->next;
+	}
+
+	if (page->next) {
+		page->next->prev = page->prev;
+	}
+
+	page->prev = page->next = NULL;
+}
+
+static SlabPage *xslab_create_page(unsigned int index)
+{
+	SlabPage *page;
+	void *ptr;
+
+	if (posix_memalign(&ptr, XSLAB_PAGE_SIZE, XSLAB_PAGE_SIZE) != 0) {
+		fatal("Error allocate memory");
+	}
+
+	xmalloc_update_stat_alloc(XSLAB_PAGE_SIZE);
+	slab_memory += XSLAB_PAGE_SIZE;
+
+	page = (SlabPage*)ptr;
+	page->prev = page->next = NULL;
+	page->free = NULL;
+	page->unused = (char*)ptr + XSLAB_HEADER_SIZE;
+	page->inuse = 0;
+	page->sclass = index;
+
+	return page;
+}
+
+static void xslab_release_page(SlabPage *page)
+{
+	xmalloc_update_stat_free(XSLAB_PAGE_SIZE);
+	slab_memory -= XSLAB_PAGE_SIZE;
+
+	free(page);
+}
+
+void *xslab_alloc(size_t size)
+{
+	SlabClass *sclass;
+	SlabPage *page;
+	unsigned int index;
+	size_t chunk;
+	void *ptr;
+
+	if (size == 0 || size > XSLAB_MAX_SIZE) {
+		return xmalloc(size);
+	}
+
+	index = XSLAB_CLASS(size);
+	chunk = XSLAB_CHUNK_SIZE(index);
+	sclass = &slab_classes[index];
+
+	page = sclass->pages;
+	if (!page) {
+		page = xslab_create_page(index);
+		xslab_link_page(sclass, page);
+	}
+
+	if (page->free) {
+		ptr = page->free;
+		page->free = *((void**)ptr);
+	} else {
+		ptr = page->unused;
+		page->unused += chunk;
+	}
+
+	page->inuse++;
+
+	if (!page->free && page->unused + chunk > (char*)page + XSLAB_PAGE_SIZE) {
+		xslab_unlink_page(sclass, page);
+	}
+
+	return ptr;
+}
+
+void *xslab_calloc(size_t size)
+{
+	void *ptr = xslab_alloc(size);
+
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+void xslab_free(void *ptr, size_t size)
+{
+	SlabClass *sclass;
+	SlabPage *page;
+	size_t chunk;
+	int full;
+
+	if (!ptr) {
+		return;
+	}
+
+	if (size == 0 || size > XSLAB_MAX_SIZE) {
+		xfree(ptr);
+		return;
+	}
+
+	page = XSLAB_PAGE(ptr);
+	sclass = &slab_classes[page->sclass];
+	chunk = XSLAB_CHUNK_SIZE(page->sclass);
+
+	full = !page->free && page->unused + chunk > (char*)page + XSLAB_PAGE_SIZE;
+
+	*((void**)ptr) = page->free;
+	page->free = ptr;
+	page->inuse--;
+
+	if (full) {
+		xslab_link_page(sclass, page);
+	}
+
+	if (page->inuse == 0 && (sclass->pages != page || page->next))
+	{
+		xslab_unlink_page(sclass, page);
+		xslab_release_page(page);
+	}
+}
+
+size_t xslab_used_memory(void)
+{
+	return slab_memory;
+}
+
+static void *xarena_map(size_t size)
+{
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (ptr == MAP_FAILED) {
+		fatal("Error allocate memory");
+	}
+
+#ifdef MADV_DONTFORK
+	madvise(ptr, size, MADV_DONTFORK);
+#endif
+
+	return ptr;
+}
+
+static unsigned int xarena_class(size_t size)
+{
+	unsigned int index = 0;
+
+	while (XARENA_BLOCK_SIZE(index) < size) {
+		index++;
+	}
+
+	return index;
+}
+
+static void xarena_grow(unsigned int index)
+{
+	size_t block = XARENA_BLOCK_SIZE(index);
+	char *chunk = xarena_map(XARENA_CHUNK_SIZE);
+	ArenaBlock *node;
+	size_t offset;
+
+	for (offset = XARENA_CHUNK_SIZE; offset >= block; offset -= block)
+	{
+		node = (ArenaBlock*)(chunk + offset - block);
+		node->next = arena_classes[index];
+		arena_classes[index] = node;
+	}
+}
+
+void *xarena_alloc(size_t size)
+{
+	ArenaBlock *node;
+	unsigned int index;
+
+	if (size > XARENA_MAX_SIZE)
+	{
+		xmalloc_update_stat_alloc(size);
+		arena_memory += size;
+		return xarena_map(size);
+	}
+
+	index = xarena_class(size);
+
+	if (!arena_classes[index]) {
+		xarena_grow(index);
+	}
+
+	node = arena_classes[index];
+	arena_classes[index] = node->next;
+
+	xmalloc_update_stat_alloc(XARENA_BLOCK_SIZE(index));
+	arena_memory += XARENA_BLOCK_SIZE(index);
+
+	return node;
+}
+
+void xarena_free(void *ptr, size_t size)
+{
+	ArenaBlock *node = ptr;
+	unsigned int index;
+
+	if (!ptr) {
+		return;
+	}
+
+	if (size > XARENA_MAX_SIZE)
+	{
+		xmalloc_update_stat_free(size);
+		arena_memory -= size;
+		munmap(ptr, size);
+		return;
+	}
+
+	index = xarena_class(size);
+
+	node->next = arena_classes[index];
+	arena_classes[index] = node;
+
+	xmalloc_update_stat_free(XARENA_BLOCK_SIZE(index));
+	arena_memory -= XARENA_BLOCK_SIZE(index);
+}
+
+size_t xarena_used_memory(void)
+{
+	return arena_memory;
+}
+
 #ifndef HAVE_MALLOC_SIZE
 size_t xmalloc_size(void *ptr)
 {
@@ -50,11 +50,28 @@
 #endif
 #endif
 
+#define XSLAB_ALIGN 8
+#define XSLAB_MAX_SIZE 512
+#define XSLAB_CLASSES (XSLAB_MAX_SIZE / XSLAB_ALIGN)
+#define XSLAB_PAGE_SIZE 65536
+
+#define XARENA_MIN_SIZE 4096
+#define XARENA_MAX_SIZE 65536
+#define XARENA_CLASSES 5
+#define XARENA_CHUNK_SIZE (1024 * 1024)
+
 void *xmalloc(size_t size);
 void *xcalloc(size_t size);
 void *xrealloc(void *ptr, size_t size);
 char *xstrdup(const char *str);
 void xfree(void *ptr);
+void *xslab_alloc(size_t size);
+void *xslab_calloc(size_t size);
+void xslab_free(void *ptr, size_t size);
+size_t xslab_used_memory(void);
+void *xarena_alloc(size_t size);
+void xarena_free(void *ptr, size_t size);
+size_t xarena_used_memory(void);
 size_t xmalloc_used_memory(void);
 void xmalloc_state_lock_on(void);
 size_t xmalloc_memory_rss(void);